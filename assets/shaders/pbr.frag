@@ -7,6 +7,7 @@ layout (location = 0) in vec3 inWorldPos;
 layout (location = 1) in vec3 inNorm;
 layout (location = 2) in vec2 inTexCoord_0;
 layout (location = 3) in vec2 inTexCoord_1;
+layout (location = 4) flat in uint inInstanceIdx;
 
 layout (set = 0, binding = 0) uniform Camera {
     mat4 projection;
@@ -25,7 +26,7 @@ layout (set = 0, binding = 1) uniform Scene {
     float debugViewEquation;
 } scene;
 
-layout (set = 2, binding = 1) uniform Material {
+struct Material {
     vec4 baseColorFactor;
     vec4 emissiveFactor;
     vec4 diffuseFactor;
@@ -40,7 +41,14 @@ layout (set = 2, binding = 1) uniform Material {
     float roughnessFactor;
     float alphaMask;
     float alphaMaskCutoff;
-} material;
+};
+
+layout (std430, set = 2, binding = 1) readonly buffer Materials {
+    Material data[];
+} materials;
+
+// Filled in from the instance's entry at the start of main
+Material material;
 
 layout (set = 0, binding = 2) uniform samplerCube samplerIrradiance;
 layout (set = 0, binding = 3) uniform samplerCube prefilteredMap;
@@ -212,6 +220,7 @@ float convertMetallic(vec3 diffuse, vec3 specular, float maxSpecular) {
 
 void main()
 {
+    material = materials.data[inInstanceIdx];
     float perceptualRoughness;
     float metallic;
     vec3 diffuseColor;
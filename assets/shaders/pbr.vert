@@ -18,18 +18,29 @@ layout (set = 0, binding = 0) uniform Camera
     vec3 pos;
 } camera;
 
-layout (set = 2, binding = 0) uniform Model
+struct Instance
 {
     mat4 transform;
-//    mat4 matrix;
 //    mat4 jointMatrix[MAX_NUM_JOINTS];
 //    float jointCount;
-} model;
+};
+
+layout (std430, set = 2, binding = 0) readonly buffer Instances
+{
+    Instance data[];
+} instances;
+
+// Draws only cover the visible instances, this maps each back to its data
+layout (std430, set = 2, binding = 2) readonly buffer InstanceIndices
+{
+    uint data[];
+} instanceIndices;
 
 layout (location = 0) out vec3 outWorldPos;
 layout (location = 1) out vec3 outNorm;
 layout (location = 2) out vec2 outTexCoord_0;
 layout (location = 3) out vec2 outTexCoord_1;
+layout (location = 4) flat out uint outInstanceIdx;
 
 out gl_PerVertex
 {
@@ -38,11 +49,14 @@ out gl_PerVertex
 
 void main()
 {
+    uint instanceIdx = instanceIndices.data[gl_InstanceIndex];
+    mat4 transform = instances.data[instanceIdx].transform;
     mat4 vpc = camera.clip * camera.proj * camera.view;
-    vec4 worldPos = model.transform * vec4(inPosition, 1.0);
+    vec4 worldPos = transform * vec4(inPosition, 1.0);
     gl_Position =  vpc * worldPos;
     outWorldPos = worldPos.xyz;
-    outNorm = normalize(transpose(inverse(mat3(model.transform))) * inNormal);
+    outNorm = normalize(transpose(inverse(mat3(transform))) * inNormal);
     outTexCoord_0 = inTexCoord_0;
     outTexCoord_1 = inTexCoord_1;
+    outInstanceIdx = instanceIdx;
 }
@@ -2,25 +2,59 @@
 
 #include "game_pch.hpp"
 
+#include "state.hpp"
 #include "plugin.hpp"
 #include "assets.hpp"
-#include "collections/circular_buffer.hpp"
+#include "scheduler.hpp"
+#include "thread_pool.hpp"
+#include "collections/tick_ring.hpp"
 
 using Context = entt::registry::context;
 
 struct World : entt::registry {
 };
 
-constexpr size_t BufferSize = 4096;
+// Sixteen seconds at the default tick rate, far more than rollback ever needs to go back
+constexpr size_t InputHistoryTicks = 1024;
+constexpr size_t MaxInputsPerTick = 8;
+
+// How far back a server correction can rewind the local player, two seconds at the default tick rate
+constexpr size_t RollbackTicks = 128;
+
+using InputHistory = tick_ring<InputRecord, InputHistoryTicks, MaxInputsPerTick>;
+using PlayerHistory = tick_ring<PlayerSnapshot, RollbackTicks, MaxInputsPerTick>;
+
+// Stand-ins for whole worlds when declaring system access, render worlds are declared by role since they swap every frame
+// Systems that create or destroy logic entities, or iterate all of them, declare the logic world on top of the components they touch
+struct LogicWorldAccess {
+};
+
+struct FrontRenderWorldAccess {
+};
+
+struct BackRenderWorldAccess {
+};
 
 struct App {
+    // Declared first so it outlives everything that may have work queued on it
+    ThreadPool threadPool;
     World logicWorld;
-    World renderWorld;
-    circular_buffer<World, BufferSize> cmdWorldHistory;
+    // Double buffered so the simulation can extract the next frame into one while the other is being rendered
+    std::array<World, 2> renderWorlds;
+    size_t renderWorldIdx = 0;
+    InputHistory inputHistory;
+    PlayerHistory playerHistory;
     Context globalCtx;
     ModelAssets modelAssets;
+    ModelStreamer modelStreamer{threadPool};
+    Scheduler scheduler;
     std::vector<std::shared_ptr<Plugin>> plugins;
 
+    App() = default;
+
+    /** @param threadCount Workers in the pool, a server sharing its host with many others wants few */
+    explicit App(size_t threadCount) : threadPool(threadCount) {}
+
     template<std::derived_from<Plugin> TPlugin, typename ...TParams>
     std::shared_ptr<TPlugin> makePlugin(TParams&& ... params) {
         auto plugin = std::make_shared<TPlugin>(std::forward<TParams>(params)...);
@@ -29,5 +63,18 @@ struct App {
         return plugin;
     }
 
+    World& renderWorld() {
+        return renderWorlds[renderWorldIdx];
+    }
+
+    World& extractWorld() {
+        return renderWorlds[renderWorldIdx ^ 1];
+    }
+
+    /** @brief Only call at the sync point, when neither the simulation nor the renderer is running */
+    void swapRenderWorlds() {
+        renderWorldIdx ^= 1;
+    }
+
     ~App();
 };
\ No newline at end of file
@@ -4,6 +4,109 @@
 #define STBI_MSC_SECURE_CRT
 
 #include "assets.hpp"
+#include "thread_pool.hpp"
+
+mat4 calcNodeTransform(tinygltf::Node const& node) {
+    if (node.matrix.size() == 16) {
+        // Column major like ours
+        mat4 m{};
+        for (size_t i = 0; i < 16; ++i) m[i / 4][i % 4] = node.matrix[i];
+        return m;
+    }
+
+    std::array<double, 3> t{0.0, 0.0, 0.0}, s{1.0, 1.0, 1.0};
+    std::array<double, 4> r{0.0, 0.0, 0.0, 1.0};
+    std::copy_n(node.translation.begin(), std::min<size_t>(node.translation.size(), 3), t.begin());
+    std::copy_n(node.scale.begin(), std::min<size_t>(node.scale.size(), 3), s.begin());
+    std::copy_n(node.rotation.begin(), std::min<size_t>(node.rotation.size(), 4), r.begin());
+    auto [x, y, z, w] = r;
+    return {
+            vec4{(1.0 - 2.0 * (y * y + z * z)) * s[0], 2.0 * (x * y + w * z) * s[0], 2.0 * (x * z - w * y) * s[0], 0.0},
+            vec4{2.0 * (x * y - w * z) * s[1], (1.0 - 2.0 * (x * x + z * z)) * s[1], 2.0 * (y * z + w * x) * s[1], 0.0},
+            vec4{2.0 * (x * z + w * y) * s[2], 2.0 * (y * z - w * x) * s[2], (1.0 - 2.0 * (x * x + y * y)) * s[2], 0.0},
+            vec4{t[0], t[1], t[2], 1.0},
+    };
+}
+
+vec3 toVec3(vec4 const& v) {
+    return {v.x, v.y, v.z};
+}
+
+ModelPrimitive makeModelPrimitive(tinygltf::Primitive const& primitive, mat4 const& transform) {
+    // Columns of the cofactor matrix are cross products of the other two columns
+    vec3 a = toVec3(transform[0]), b = toVec3(transform[1]), c = toVec3(transform[2]);
+    vec3 bc = edyn::cross(b, c), ca = edyn::cross(c, a), ab = edyn::cross(a, b);
+    bool isMirrored = edyn::dot(a, bc) < 0.0;
+    double sign = isMirrored ? -1.0 : 1.0;
+    mat4 normalTransform{
+            vec4{bc.x, bc.y, bc.z, 0.0} * sign,
+            vec4{ca.x, ca.y, ca.z, 0.0} * sign,
+            vec4{ab.x, ab.y, ab.z, 0.0} * sign,
+            vec4{0.0, 0.0, 0.0, 1.0},
+    };
+    return {&primitive, transform, normalTransform, isMirrored};
+}
+
+std::vector<ModelPrimitive> collectPrimitives(Model const& model) {
+    std::vector<ModelPrimitive> primitives;
+    auto addMesh = [&](tinygltf::Mesh const& mesh, mat4 const& transform) {
+        for (tinygltf::Primitive const& primitive: mesh.primitives) {
+            bool isTriangles = primitive.mode == -1 || primitive.mode == TINYGLTF_MODE_TRIANGLES;
+            if (!isTriangles || !primitive.attributes.contains("POSITION")) continue;
+
+            primitives.push_back(makeModelPrimitive(primitive, transform));
+        }
+    };
+
+    if (model.scenes.empty()) {
+        for (tinygltf::Mesh const& mesh: model.meshes) addMesh(mesh, matrix4x4_identity);
+        return primitives;
+    }
+
+    tinygltf::Scene const& scene = model.scenes.at(model.defaultScene >= 0 ? model.defaultScene : 0);
+    std::vector<std::pair<int, mat4>> stack;
+    for (int nodeIdx: scene.nodes) stack.emplace_back(nodeIdx, matrix4x4_identity);
+    while (!stack.empty()) {
+        auto [nodeIdx, parentTransform] = stack.back();
+        stack.pop_back();
+        tinygltf::Node const& node = model.nodes.at(nodeIdx);
+        mat4 transform = parentTransform * calcNodeTransform(node);
+        if (node.mesh >= 0) addMesh(model.meshes.at(node.mesh), transform);
+        for (int childIdx: node.children) stack.emplace_back(childIdx, transform);
+    }
+    return primitives;
+}
+
+Bounds calcModelBounds(Model const& model) {
+    std::vector<ModelPrimitive> primitives = collectPrimitives(model);
+    if (primitives.empty()) {
+        throw std::runtime_error("Model has no triangles");
+    }
+
+    // Transformed corners of each primitive's box, which is conservative under rotation
+    constexpr scalar inf = std::numeric_limits<scalar>::infinity();
+    vec3 min{inf, inf, inf}, max{-inf, -inf, -inf};
+    for (ModelPrimitive const& primitive: primitives) {
+        tinygltf::Accessor const& positions = model.accessors.at(primitive.primitive->attributes.at("POSITION"));
+        if (positions.minValues.size() != 3 || positions.maxValues.size() != 3) {
+            throw std::runtime_error("Model position accessor has no min and max");
+        }
+
+        for (size_t corner = 0; corner < 8; ++corner) {
+            vec4 local{
+                    corner & 1 ? positions.maxValues[0] : positions.minValues[0],
+                    corner & 2 ? positions.maxValues[1] : positions.minValues[1],
+                    corner & 4 ? positions.maxValues[2] : positions.minValues[2],
+                    1.0
+            };
+            vec3 point = toVec3(primitive.transform * local);
+            min = edyn::min(min, point);
+            max = edyn::max(max, point);
+        }
+    }
+    vec3 center = (min + max) * 0.5;
+    return {min, max, center, edyn::length(max - center)};
+}
 
 ModelLoader::result_type ModelLoader::operator()(std::string_view name) {
     tinygltf::TinyGLTF loader;
@@ -17,3 +120,27 @@ ModelLoader::result_type ModelLoader::operator()(std::string_view name) {
     }
     return model;
 }
+
+void ModelStreamer::request(ModelAssets const& assets, entt::id_type handle, std::string path) {
+    if (assets.contains(handle) || mPending.contains(handle)) return;
+
+    mPending.emplace(handle, mPool.submit([path = std::move(path)] { return ModelLoader{}(path); }));
+}
+
+size_t ModelStreamer::collect(ModelAssets& assets) {
+    size_t collectedCount = 0;
+    for (auto it = mPending.begin(); it != mPending.end();) {
+        auto& [handle, future] = *it;
+        if (future.wait_for(ns_t::zero()) != std::future_status::ready) {
+            ++it;
+            continue;
+        }
+
+        // Throws here on the calling thread if the load failed
+        auto [_, wasAdded] = assets.load(handle, future.get());
+        GAME_ASSERT(wasAdded);
+        collectedCount++;
+        it = mPending.erase(it);
+    }
+    return collectedCount;
+}
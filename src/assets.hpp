@@ -2,14 +2,78 @@
 
 #include "game_pch.hpp"
 
+#include <future>
 #include <tiny_gltf.h>
 
+#include "matrix4x4.hpp"
+
+class ThreadPool;
+
 using Model = tinygltf::Model;
 
+/** @brief Model space extents of a model, the sphere encloses the box */
+struct Bounds {
+    vec3 min, max;
+    vec3 center;
+    scalar radius;
+};
+
+/** @brief A triangle primitive of a model along with where its node hierarchy places it in model space */
+struct ModelPrimitive {
+    tinygltf::Primitive const* primitive;
+    mat4 transform;
+    // Inverse transpose of the upper 3x3 of the transform up to scale, for normals, the fourth column is unused
+    mat4 normalTransform;
+    // Mirroring transforms turn triangles inside out, so their winding has to be reversed
+    bool isMirrored;
+};
+
+/**
+ * @brief Every triangle primitive of every node in the model's default scene, with transforms accumulated down the hierarchy.
+ *        Models without a scene get every mesh as it is.
+ */
+std::vector<ModelPrimitive> collectPrimitives(Model const& model);
+
+/** @brief Reads the extents glTF requires position accessors to carry, so no vertex has to be touched */
+Bounds calcModelBounds(Model const& model);
+
 struct ModelLoader {
     using result_type = std::shared_ptr<Model>;
 
     result_type operator()(std::string_view name);
+
+    // Used to insert models that were already loaded on another thread
+    result_type operator()(std::shared_ptr<Model> model) {
+        return model;
+    }
 };
 
 using ModelAssets = entt::resource_cache<Model, ModelLoader>;
+
+/**
+ * @brief Loads models on a thread pool so file IO and parsing never stall a frame.
+ *
+ * Finished loads are only moved into the cache from the thread that calls collect,
+ * so the cache itself is never touched concurrently.
+ */
+class ModelStreamer {
+private:
+    ThreadPool& mPool;
+    std::unordered_map<entt::id_type, std::future<ModelLoader::result_type>> mPending;
+
+public:
+    explicit ModelStreamer(ThreadPool& pool) : mPool(pool) {}
+
+    /** @brief Starts loading the model in the background, unless it is already resident or on its way */
+    void request(ModelAssets const& assets, entt::id_type handle, std::string path);
+
+    /**
+     * @brief Moves every finished load into the cache. Rethrows any error a load ran into.
+     * @return  How many models became resident
+     */
+    size_t collect(ModelAssets& assets);
+
+    [[nodiscard]] size_t pendingCount() const {
+        return mPending.size();
+    }
+};
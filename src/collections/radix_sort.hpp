@@ -0,0 +1,50 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+/**
+ * @brief Stable least significant digit radix sort on 64 bit keys, one byte per pass.
+ *
+ * Histograms for every pass are built in a single read of the keys up front.
+ * Passes over a byte every key shares are skipped, so bits a key layout leaves unused cost nothing.
+ *
+ * @param scratch   Reused between calls so sorting every frame does not allocate, left holding garbage
+ * @param key_of    Returns the key of an item, called once per item per pass that is not skipped
+ */
+template<typename T, typename TKeyOf>
+void radix_sort(std::vector<T>& items, std::vector<T>& scratch, TKeyOf&& key_of) {
+    constexpr size_t digit_bits = 8;
+    constexpr size_t digit_count = size_t{1} << digit_bits;
+    constexpr size_t pass_count = 64 / digit_bits;
+    size_t const item_count = items.size();
+    if (item_count < 2) return;
+
+    std::array<std::array<size_t, digit_count>, pass_count> histograms{};
+    for (T const& item: items) {
+        uint64_t key = key_of(item);
+        for (size_t pass = 0; pass < pass_count; ++pass) {
+            histograms[pass][(key >> (pass * digit_bits)) & (digit_count - 1)]++;
+        }
+    }
+
+    scratch.resize(item_count);
+    for (size_t pass = 0; pass < pass_count; ++pass) {
+        std::array<size_t, digit_count>& offsets = histograms[pass];
+        bool is_shared = std::any_of(offsets.begin(), offsets.end(), [item_count](size_t count) { return count == item_count; });
+        if (is_shared) continue;
+
+        size_t sum = 0;
+        for (size_t& offset: offsets) {
+            size_t count = offset;
+            offset = sum;
+            sum += count;
+        }
+        for (T& item: items) {
+            scratch[offsets[(key_of(item) >> (pass * digit_bits)) & (digit_count - 1)]++] = std::move(item);
+        }
+        items.swap(scratch);
+    }
+}
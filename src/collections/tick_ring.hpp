@@ -0,0 +1,87 @@
+#pragma once
+
+#include <span>
+#include <array>
+#include <vector>
+#include <stdexcept>
+
+/**
+ * @brief Fixed size history of records grouped by tick, stored flat with a fixed number of records per tick.
+ *
+ * The slot of a tick is its number modulo Size, so looking up a tick is constant time.
+ * Recording a tick overwrites the one Size ticks before it, lookups of overwritten ticks come back empty.
+ */
+template<typename T, size_t Size, size_t MaxPerTick>
+class tick_ring {
+private:
+    struct slot {
+        size_t tick;
+        size_t count;
+        bool is_valid;
+    };
+
+    std::vector<T> mRecords;
+    std::array<slot, Size> mSlots{};
+
+    slot const* find_slot(size_t tick) const {
+        slot const& s = mSlots[tick % Size];
+        return s.is_valid && s.tick == tick ? &s : nullptr;
+    }
+
+public:
+    tick_ring() : mRecords(Size * MaxPerTick) {}
+
+    /** @brief Starts recording a tick, discarding whatever was recorded for it or in its slot before */
+    void begin_tick(size_t tick) {
+        mSlots[tick % Size] = {tick, 0, true};
+    }
+
+    void push(size_t tick, T const& record) {
+        slot& s = mSlots[tick % Size];
+        if (!s.is_valid || s.tick != tick) {
+            throw std::runtime_error("Tick is not being recorded");
+        }
+        if (s.count == MaxPerTick) {
+            throw std::runtime_error("Too many records for one tick");
+        }
+        mRecords[(tick % Size) * MaxPerTick + s.count++] = record;
+    }
+
+    [[nodiscard]] bool contains(size_t tick) const {
+        return find_slot(tick) != nullptr;
+    }
+
+    [[nodiscard]] std::span<T const> at(size_t tick) const {
+        slot const* s = find_slot(tick);
+        if (!s) return {};
+
+        return {mRecords.data() + (tick % Size) * MaxPerTick, s->count};
+    }
+
+    [[nodiscard]] std::span<T> at(size_t tick) {
+        slot const* s = find_slot(tick);
+        if (!s) return {};
+
+        return {mRecords.data() + (tick % Size) * MaxPerTick, s->count};
+    }
+
+    template<typename TPredicate>
+    [[nodiscard]] T* find(size_t tick, TPredicate&& predicate) {
+        for (T& record: at(tick)) {
+            if (predicate(record)) return &record;
+        }
+        return nullptr;
+    }
+
+    template<typename TPredicate>
+    [[nodiscard]] T const* find(size_t tick, TPredicate&& predicate) const {
+        for (T const& record: at(tick)) {
+            if (predicate(record)) return &record;
+        }
+        return nullptr;
+    }
+
+    static constexpr size_t capacity() {
+        return Size;
+    }
+};
@@ -0,0 +1,123 @@
+#include "extract.hpp"
+
+#include "app.hpp"
+#include "state.hpp"
+
+template<typename... TComps>
+void copyComponents(World const& src, World& dst, entt::entity ent) {
+    if (!dst.valid(ent)) {
+        auto actualEnt = dst.create(ent);
+        GAME_ASSERT(actualEnt == ent);
+    }
+    (dst.emplace_or_replace<TComps>(ent, src.get<TComps>(ent)), ...);
+}
+
+/** @brief Only entities that have been through a tick have a previous transform */
+void copyPreviousTransform(World const& src, World& dst, entt::entity ent) {
+    if (auto* prev = src.try_get<PreviousTransform>(ent)) {
+        dst.emplace_or_replace<PreviousTransform>(ent, *prev);
+    } else {
+        dst.remove<PreviousTransform>(ent);
+    }
+}
+
+bool isDrawable(World const& world, entt::entity ent) {
+    return world.all_of<Position, Orientation, Material, ModelHandle>(ent);
+}
+
+bool isPlayer(World const& world, entt::entity ent) {
+    return world.all_of<Position, Look, Player>(ent);
+}
+
+void ExtractPlugin::build(App& app) {
+    // Picks up entities becoming drawable as well as any drawable component being replaced or patched afterwards
+    mDrawableObserver.connect(app.logicWorld, entt::collector
+            .group<Position, Orientation, Material, ModelHandle>()
+            .update<Position>().where<Orientation, Material, ModelHandle>()
+            .update<Orientation>().where<Position, Material, ModelHandle>()
+            .update<Material>().where<Position, Orientation, ModelHandle>()
+            .update<ModelHandle>().where<Position, Orientation, Material>()
+            .update<PreviousTransform>().where<Position, Orientation, Material, ModelHandle>());
+
+    app.logicWorld.on_destroy<Position>().connect<&ExtractPlugin::onRemoved>(*this);
+    app.logicWorld.on_destroy<Orientation>().connect<&ExtractPlugin::onRemoved>(*this);
+    app.logicWorld.on_destroy<Material>().connect<&ExtractPlugin::onRemoved>(*this);
+    app.logicWorld.on_destroy<ModelHandle>().connect<&ExtractPlugin::onRemoved>(*this);
+    app.logicWorld.on_destroy<Player>().connect<&ExtractPlugin::onRemoved>(*this);
+}
+
+void ExtractPlugin::access(SystemAccess& access) {
+    access.read<LogicWorldAccess, LocalContext, SimulationClock, Position, Orientation, PreviousTransform, Material, ModelHandle, Look, Player>()
+            .write<BackRenderWorldAccess>();
+}
+
+void ExtractPlugin::onRemoved(entt::registry&, entt::entity ent) {
+    mRemoved.push_back(ent);
+}
+
+void applyRemovals(World const& logicWorld, World& renderWorld, std::vector<entt::entity> const& removed) {
+    for (entt::entity ent: removed) {
+        if (!renderWorld.valid(ent)) continue;
+
+        bool isStillExtracted = logicWorld.valid(ent) && (isDrawable(logicWorld, ent) || isPlayer(logicWorld, ent));
+        if (isStillExtracted) {
+            if (!isDrawable(logicWorld, ent)) renderWorld.remove<Position, Orientation, Material, ModelHandle, ShaderHandle>(ent);
+            if (!isPlayer(logicWorld, ent)) renderWorld.remove<Look, Player>(ent);
+        } else {
+            renderWorld.destroy(ent);
+        }
+    }
+}
+
+void applyDirty(World const& logicWorld, World& renderWorld, std::vector<entt::entity> const& dirty) {
+    for (entt::entity ent: dirty) {
+        if (!logicWorld.valid(ent) || !isDrawable(logicWorld, ent)) continue;
+
+        copyComponents<Position, Orientation, Material, ModelHandle>(logicWorld, renderWorld, ent);
+        copyPreviousTransform(logicWorld, renderWorld, ent);
+        renderWorld.emplace_or_replace<ShaderHandle>(ent, "Flat"_hs);
+    }
+}
+
+void ExtractPlugin::execute(App& app) {
+    World const& logicWorld = app.logicWorld;
+    World& renderWorld = app.extractWorld();
+    renderWorld.ctx().emplace<RenderContext>() = RenderContext{
+            logicWorld.ctx().at<LocalContext>().possessionId,
+            app.globalCtx.at<SimulationClock>().alpha
+    };
+
+    std::vector<entt::entity> dirty(mDrawableObserver.begin(), mDrawableObserver.end());
+    mDrawableObserver.clear();
+
+    // Removals go first so an entity that lost and regained a component is extracted again right after
+    // Last frame's changes are replayed first since this frame's are newer, copies always read the current logic state anyway
+    applyRemovals(logicWorld, renderWorld, mPrevRemoved);
+    applyRemovals(logicWorld, renderWorld, mRemoved);
+    applyDirty(logicWorld, renderWorld, mPrevDirty);
+    applyDirty(logicWorld, renderWorld, dirty);
+    mPrevRemoved = std::move(mRemoved);
+    mRemoved.clear();
+    mPrevDirty = std::move(dirty);
+
+    // Physics and the player controller write these in place without patching, so they are copied every frame
+    // There are only a handful of them compared to static drawables
+    for (entt::entity ent: logicWorld.view<const Position, const Look, const Player>()) {
+        copyComponents<Position, Look, Player>(logicWorld, renderWorld, ent);
+        copyPreviousTransform(logicWorld, renderWorld, ent);
+    }
+    auto dynamicView = logicWorld.view<const edyn::dynamic_tag, const Position, const Orientation, const Material, const ModelHandle>();
+    for (entt::entity ent: dynamicView) {
+        copyComponents<Position, Orientation>(logicWorld, renderWorld, ent);
+        copyPreviousTransform(logicWorld, renderWorld, ent);
+    }
+}
+
+void ExtractPlugin::cleanup(App& app) {
+    mDrawableObserver.disconnect();
+    app.logicWorld.on_destroy<Position>().disconnect(*this);
+    app.logicWorld.on_destroy<Orientation>().disconnect(*this);
+    app.logicWorld.on_destroy<Material>().disconnect(*this);
+    app.logicWorld.on_destroy<ModelHandle>().disconnect(*this);
+    app.logicWorld.on_destroy<Player>().disconnect(*this);
+}
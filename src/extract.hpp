@@ -0,0 +1,31 @@
+#pragma once
+
+#include "game_pch.hpp"
+
+#include "plugin.hpp"
+
+/**
+ * @brief Mirrors what the renderer needs from the logic world into the render world.
+ *
+ * Entities keep their storage in the render world between frames, only components that changed are copied over.
+ * Changes are picked up through signals, so anything that modifies a drawable component in place must patch it.
+ * Render worlds are double buffered, so every change is applied to the buffer extracted into this frame and again to the other one next frame.
+ */
+class ExtractPlugin : public Plugin {
+public:
+    void access(SystemAccess& access) override;
+
+    void build(App& app) override;
+
+    void execute(App& app) override;
+
+    void cleanup(App& app) override;
+
+private:
+    entt::observer mDrawableObserver;
+    std::vector<entt::entity> mRemoved;
+    // Changes made last frame, which the buffer being extracted into this frame has not seen yet
+    std::vector<entt::entity> mPrevDirty, mPrevRemoved;
+
+    void onRemoved(entt::registry& registry, entt::entity ent);
+};
@@ -0,0 +1,99 @@
+#include "culling.hpp"
+
+#include <bit>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GAME_CULL_SSE
+#include <emmintrin.h>
+#endif
+
+Frustum extractFrustum(mat4 const& viewProjClip) {
+    // Gribb and Hartmann, each plane is a sum of rows. Vulkan depth goes from zero to w, hence the near plane being the z row alone
+    vec4 rowX = viewProjClip.column(0), rowY = viewProjClip.column(1), rowZ = viewProjClip.column(2), rowW = viewProjClip.column(3);
+    std::array<vec4, 6> planes{
+            rowW + rowX, rowW + rowX * -1.0,
+            rowW + rowY, rowW + rowY * -1.0,
+            rowZ, rowW + rowZ * -1.0,
+    };
+    Frustum frustum{};
+    for (size_t i = 0; i < planes.size(); ++i) {
+        vec4 const& plane = planes[i];
+        // Normalized so the distance can be compared against sphere radii directly
+        scalar length = std::sqrt(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+        scalar invLength = length > SCALAR_EPSILON ? 1.0 / length : 0.0;
+        frustum.planes[i] = {
+                static_cast<float>(plane.x * invLength), static_cast<float>(plane.y * invLength),
+                static_cast<float>(plane.z * invLength), static_cast<float>(plane.w * invLength),
+        };
+    }
+    return frustum;
+}
+
+bool isBoxVisible(Frustum const& frustum, BoundingBox const& box) {
+    // Only the corner furthest along each plane's normal needs testing
+    return std::all_of(frustum.planes.begin(), frustum.planes.end(), [&](vec4f const& plane) {
+        scalar x = plane.x >= 0.0f ? box.max.x : box.min.x;
+        scalar y = plane.y >= 0.0f ? box.max.y : box.min.y;
+        scalar z = plane.z >= 0.0f ? box.max.z : box.min.z;
+        return plane.x * x + plane.y * y + plane.z * z + plane.w >= 0.0;
+    });
+}
+
+void CullSpheres::clear() {
+    x.clear();
+    y.clear();
+    z.clear();
+    radius.clear();
+}
+
+void CullSpheres::push(vec3 const& center, scalar sphereRadius) {
+    x.push_back(static_cast<float>(center.x));
+    y.push_back(static_cast<float>(center.y));
+    z.push_back(static_cast<float>(center.z));
+    radius.push_back(static_cast<float>(sphereRadius));
+}
+
+bool isSphereVisible(Frustum const& frustum, float x, float y, float z, float radius) {
+    return std::all_of(frustum.planes.begin(), frustum.planes.end(), [&](vec4f const& plane) {
+        return plane.x * x + plane.y * y + plane.z * z + plane.w >= -radius;
+    });
+}
+
+void cullSpheres(Frustum const& frustum, CullSpheres const& spheres, std::vector<uint32_t>& visible) {
+    visible.clear();
+    size_t count = spheres.size();
+    size_t i = 0;
+#ifdef GAME_CULL_SSE
+    // Four spheres per iteration against one plane at a time, planes are splatted once up front
+    // Vector types lose their alignment attributes as template arguments, hence plain arrays
+    constexpr size_t PlaneCount = std::tuple_size_v<decltype(Frustum::planes)>;
+    __m128 nx[PlaneCount], ny[PlaneCount], nz[PlaneCount], nd[PlaneCount];
+    for (size_t p = 0; p < PlaneCount; ++p) {
+        vec4f const& plane = frustum.planes[p];
+        nx[p] = _mm_set1_ps(plane.x);
+        ny[p] = _mm_set1_ps(plane.y);
+        nz[p] = _mm_set1_ps(plane.z);
+        nd[p] = _mm_set1_ps(plane.w);
+    }
+    for (; i + 4 <= count; i += 4) {
+        __m128 x = _mm_loadu_ps(spheres.x.data() + i);
+        __m128 y = _mm_loadu_ps(spheres.y.data() + i);
+        __m128 z = _mm_loadu_ps(spheres.z.data() + i);
+        __m128 negRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(spheres.radius.data() + i));
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (size_t p = 0; p < PlaneCount; ++p) {
+            __m128 dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx[p], x), _mm_mul_ps(ny[p], y)), _mm_add_ps(_mm_mul_ps(nz[p], z), nd[p]));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(dist, negRadius));
+        }
+        int mask = _mm_movemask_ps(inside);
+        for (; mask; mask &= mask - 1) {
+            visible.push_back(static_cast<uint32_t>(i + std::countr_zero(static_cast<unsigned>(mask))));
+        }
+    }
+#endif
+    for (; i < count; ++i) {
+        if (isSphereVisible(frustum, spheres.x[i], spheres.y[i], spheres.z[i], spheres.radius[i])) {
+            visible.push_back(static_cast<uint32_t>(i));
+        }
+    }
+}
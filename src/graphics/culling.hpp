@@ -0,0 +1,36 @@
+#pragma once
+
+#include "game_pch.hpp"
+
+#include "matrix4x4.hpp"
+#include "spatial_index.hpp"
+
+/** @brief Planes point inwards, xyz is the normal and w the distance, so a point is inside when dot(n, p) + w >= 0 for all */
+struct Frustum {
+    std::array<vec4f, 6> planes;
+};
+
+/** @param viewProjClip  Full transform from world to Vulkan clip space, the same one the vertex shader applies */
+Frustum extractFrustum(mat4 const& viewProjClip);
+
+/** @brief Conservative, boxes near a corner of the frustum may pass without touching it */
+bool isBoxVisible(Frustum const& frustum, BoundingBox const& box);
+
+/** @brief World space bounding spheres laid out as a structure of arrays so the kernel can load four at a time */
+struct CullSpheres {
+    std::vector<float> x, y, z, radius;
+
+    void clear();
+
+    void push(vec3 const& center, scalar sphereRadius);
+
+    [[nodiscard]] size_t size() const {
+        return x.size();
+    }
+};
+
+/**
+ * @brief Tests every sphere against the frustum, using SSE where the target has it.
+ * @param visible   Filled with the indices of spheres that intersect the frustum, in ascending order
+ */
+void cullSpheres(Frustum const& frustum, CullSpheres const& spheres, std::vector<uint32_t>& visible);
@@ -0,0 +1,27 @@
+#include "geometry_buffer.hpp"
+
+GeometryAllocation GeometryBuffer::alloc(vk::raii::PhysicalDevice const& physDev, vk::raii::Device const& device,
+                                         vk::DeviceSize size, vk::DeviceSize alignment) {
+    GAME_ASSERT(alignment > 0);
+    auto alignUp = [alignment](vk::DeviceSize offset) { return (offset + alignment - 1) / alignment * alignment; };
+    if (!mBlocks.empty()) {
+        Block& block = mBlocks.back();
+        vk::DeviceSize offset = alignUp(block.head);
+        if (offset + size <= block.capacity) {
+            block.head = offset + size;
+            return {static_cast<uint32_t>(mBlocks.size() - 1), offset};
+        }
+    }
+
+    // Whatever is left in the last block is given up, models are uploaded a few at a time so little is lost
+    vk::DeviceSize capacity = std::max(size, mBlockSize);
+    mBlocks.push_back({vk::raii::su::BufferData(physDev, device, capacity, mUsage, vk::MemoryPropertyFlagBits::eDeviceLocal), capacity, size});
+    std::cout << "[Vulkan] Created geometry block " << mBlocks.size() - 1 << " of " << capacity << " bytes" << std::endl;
+    return {static_cast<uint32_t>(mBlocks.size() - 1), 0};
+}
+
+vk::DeviceSize GeometryBuffer::size() const {
+    vk::DeviceSize total = 0;
+    for (Block const& block: mBlocks) total += block.head;
+    return total;
+}
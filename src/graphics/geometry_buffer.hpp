@@ -0,0 +1,51 @@
+#pragma once
+
+#include "game_pch.hpp"
+
+#include <vulkan/vulkan_raii.hpp>
+
+#include "utils_raii.hpp"
+
+struct GeometryAllocation {
+    uint32_t blockIdx;
+    vk::DeviceSize offset;
+};
+
+/**
+ * @brief Device local memory that every model's vertices or indices are handed out from, in a few large blocks.
+ *
+ * Models are never unloaded, so each block is a linear allocator and a new one is only created once the last is full.
+ * Draws of models in the same block need no rebinding, and memory is not split up into a buffer per model.
+ */
+class GeometryBuffer {
+private:
+    struct Block {
+        vk::raii::su::BufferData bufData;
+        vk::DeviceSize capacity, head;
+    };
+
+    std::vector<Block> mBlocks;
+    vk::DeviceSize mBlockSize;
+    vk::BufferUsageFlags mUsage;
+
+public:
+    GeometryBuffer(vk::DeviceSize blockSize, vk::BufferUsageFlags usage)
+            : mBlockSize(blockSize), mUsage(usage | vk::BufferUsageFlagBits::eTransferDst) {}
+
+    /**
+     * @param alignment     Does not have to be a power of two, vertices are aligned to their stride so that draws can address them by vertex offset.
+     *                      Allocations larger than a block get a block of their own.
+     */
+    GeometryAllocation alloc(vk::raii::PhysicalDevice const& physDev, vk::raii::Device const& device, vk::DeviceSize size, vk::DeviceSize alignment);
+
+    [[nodiscard]] vk::Buffer buffer(uint32_t blockIdx) const {
+        return **mBlocks[blockIdx].bufData.buffer;
+    }
+
+    [[nodiscard]] size_t blockCount() const {
+        return mBlocks.size();
+    }
+
+    /** @brief Bytes handed out over all blocks */
+    [[nodiscard]] vk::DeviceSize size() const;
+};
@@ -0,0 +1,133 @@
+#include "interleave.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GAME_INTERLEAVE_SSE2
+
+#include <emmintrin.h>
+
+#endif
+
+using InterleaveKernel = void (*)(AttributeStream const& stream, std::byte* dst, size_t dstStride, size_t first, size_t count);
+
+// Small enough that a block of destination vertices stays in L1 while every attribute is written into it
+constexpr size_t InterleaveBlockSize = 64;
+
+void interleaveZero(AttributeStream const& stream, std::byte* dst, size_t dstStride, size_t first, size_t count) {
+    size_t size = stream.dstCompCount * sizeof(float);
+    dst += first * dstStride + stream.dstOffset;
+    for (size_t i = 0; i < count; ++i, dst += dstStride) {
+        std::memset(dst, 0, size);
+    }
+}
+
+void interleaveGeneric(AttributeStream const& stream, std::byte* dst, size_t dstStride, size_t first, size_t count) {
+    size_t srcSize = stream.srcCompCount * sizeof(float), dstSize = stream.dstCompCount * sizeof(float);
+    std::byte const* src = stream.src + first * stream.srcStride;
+    dst += first * dstStride + stream.dstOffset;
+    for (size_t i = 0; i < count; ++i, src += stream.srcStride, dst += dstStride) {
+        std::memcpy(dst, src, srcSize);
+        std::memset(dst + srcSize, 0, dstSize - srcSize);
+    }
+}
+
+#ifdef GAME_INTERLEAVE_SSE2
+
+void storeVertex(std::byte* dst, __m128i value) {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), value);
+}
+
+__m128i loadVertices(std::byte const* src) {
+    return _mm_loadu_si128(reinterpret_cast<__m128i const*>(src));
+}
+
+// Tightly packed sources, which is what glTF exporters usually write, are read four vertices at a time in whole registers.
+// Strided sources and the last few vertices go one at a time.
+
+void interleaveFloat2(AttributeStream const& stream, std::byte* dst, size_t dstStride, size_t first, size_t count) {
+    std::byte const* src = stream.src + first * stream.srcStride;
+    dst += first * dstStride + stream.dstOffset;
+    size_t i = 0;
+    if (stream.srcStride == 2 * sizeof(float)) {
+        for (; i + 4 <= count; i += 4, src += 8 * sizeof(float), dst += 4 * dstStride) {
+            __m128i v01 = loadVertices(src), v23 = loadVertices(src + 4 * sizeof(float));
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(dst), v01);
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + dstStride), _mm_unpackhi_epi64(v01, v01));
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + 2 * dstStride), v23);
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + 3 * dstStride), _mm_unpackhi_epi64(v23, v23));
+        }
+    }
+    for (; i < count; ++i, src += stream.srcStride, dst += dstStride) {
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(dst), _mm_loadl_epi64(reinterpret_cast<__m128i const*>(src)));
+    }
+}
+
+void interleaveFloat3To4(AttributeStream const& stream, std::byte* dst, size_t dstStride, size_t first, size_t count) {
+    std::byte const* src = stream.src + first * stream.srcStride;
+    dst += first * dstStride + stream.dstOffset;
+    size_t i = 0;
+    if (stream.srcStride == 3 * sizeof(float)) {
+        // Four vertices are exactly three registers: x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3
+        // Each vertex is shifted together from the two registers it straddles, then its fourth lane is cleared
+        __m128i const xyzMask = _mm_set_epi32(0, -1, -1, -1);
+        for (; i + 4 <= count; i += 4, src += 12 * sizeof(float), dst += 4 * dstStride) {
+            __m128i a = loadVertices(src), b = loadVertices(src + 4 * sizeof(float)), c = loadVertices(src + 8 * sizeof(float));
+            storeVertex(dst, _mm_and_si128(a, xyzMask));
+            storeVertex(dst + dstStride, _mm_and_si128(_mm_or_si128(_mm_srli_si128(a, 12), _mm_slli_si128(b, 4)), xyzMask));
+            storeVertex(dst + 2 * dstStride, _mm_and_si128(_mm_or_si128(_mm_srli_si128(b, 8), _mm_slli_si128(c, 8)), xyzMask));
+            storeVertex(dst + 3 * dstStride, _mm_srli_si128(c, 4));
+        }
+    }
+    // Loads exactly twelve bytes so the last vertex never reads past the end of the source buffer
+    for (; i < count; ++i, src += stream.srcStride, dst += dstStride) {
+        __m128 xy = _mm_castsi128_ps(_mm_loadl_epi64(reinterpret_cast<__m128i const*>(src)));
+        __m128 z = _mm_load_ss(reinterpret_cast<float const*>(src) + 2);
+        _mm_storeu_ps(reinterpret_cast<float*>(dst), _mm_movelh_ps(xy, z));
+    }
+}
+
+void interleaveFloat4(AttributeStream const& stream, std::byte* dst, size_t dstStride, size_t first, size_t count) {
+    std::byte const* src = stream.src + first * stream.srcStride;
+    dst += first * dstStride + stream.dstOffset;
+    size_t i = 0;
+    // Every load is issued before any store, so they are not held up behind stores that might alias them
+    for (; i + 4 <= count; i += 4, src += 4 * stream.srcStride, dst += 4 * dstStride) {
+        __m128i v0 = loadVertices(src), v1 = loadVertices(src + stream.srcStride);
+        __m128i v2 = loadVertices(src + 2 * stream.srcStride), v3 = loadVertices(src + 3 * stream.srcStride);
+        storeVertex(dst, v0);
+        storeVertex(dst + dstStride, v1);
+        storeVertex(dst + 2 * dstStride, v2);
+        storeVertex(dst + 3 * dstStride, v3);
+    }
+    for (; i < count; ++i, src += stream.srcStride, dst += dstStride) {
+        storeVertex(dst, loadVertices(src));
+    }
+}
+
+#endif
+
+InterleaveKernel pickKernel(AttributeStream const& stream) {
+    GAME_ASSERT(stream.srcCompCount <= stream.dstCompCount || !stream.src);
+    if (!stream.src) return interleaveZero;
+#ifdef GAME_INTERLEAVE_SSE2
+    if (stream.srcCompCount == 2 && stream.dstCompCount == 2) return interleaveFloat2;
+    if (stream.srcCompCount == 3 && stream.dstCompCount == 4) return interleaveFloat3To4;
+    if (stream.srcCompCount == 4 && stream.dstCompCount == 4) return interleaveFloat4;
+#endif
+    return interleaveGeneric;
+}
+
+void interleaveVertices(std::span<AttributeStream const> streams, std::byte* dst, size_t dstStride, size_t vertCount) {
+    std::vector<InterleaveKernel> kernels;
+    kernels.reserve(streams.size());
+    for (AttributeStream const& stream: streams) {
+        GAME_ASSERT(stream.dstOffset + stream.dstCompCount * sizeof(float) <= dstStride);
+        kernels.push_back(pickKernel(stream));
+    }
+
+    for (size_t first = 0; first < vertCount; first += InterleaveBlockSize) {
+        size_t count = std::min(InterleaveBlockSize, vertCount - first);
+        for (size_t i = 0; i < streams.size(); ++i) {
+            kernels[i](streams[i], dst, dstStride, first, count);
+        }
+    }
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "game_pch.hpp"
+
+#include <span>
+
+/** @brief One attribute of a vertex, read from its own (possibly strided) source array */
+struct AttributeStream {
+    // Null when the model does not have this attribute, in which case its slot is zeroed
+    std::byte const* src;
+    size_t srcStride;
+    uint32_t srcCompCount;
+    // Float components written per vertex, anything past the source components is zeroed
+    uint32_t dstCompCount;
+    uint32_t dstOffset;
+};
+
+/**
+ * @brief Writes every attribute of every vertex into an interleaved vertex buffer.
+ *
+ * Works on blocks of vertices that fit in cache, so the destination is only walked once no matter how many attributes there are.
+ * Only 32-bit float components are supported.
+ */
+void interleaveVertices(std::span<AttributeStream const> streams, std::byte* dst, size_t dstStride, size_t vertCount);
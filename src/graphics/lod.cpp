@@ -0,0 +1,72 @@
+#include "lod.hpp"
+
+// Grid cells along each axis of the model bounds for every generated level, coarser ones come later
+constexpr std::array<uint32_t, 4> LodGridSizes{32, 16, 8, 4};
+// Levels that keep more than this share of the triangles of the level before are not worth an extra level
+constexpr double MinLodReduction = 0.75;
+// Screen sizes below which each level switches to the next coarser one
+constexpr std::array<double, MaxLodLevels - 1> LodScreenSizes{0.25, 0.1, 0.04};
+// Fraction of a threshold a screen size has to move past it before the level changes
+constexpr double LodHysteresis = 0.15;
+
+/** @brief Maps every vertex to the first vertex that landed in the same grid cell */
+std::vector<uint32_t> clusterVertices(std::span<vec3f const> positions, Bounds const& bounds, uint32_t gridSize) {
+    vec3 extent = bounds.max - bounds.min;
+    auto cellOf = [&](float value, size_t axis) {
+        if (extent[axis] <= 0.0) return uint32_t{0};
+
+        double cell = (static_cast<double>(value) - bounds.min[axis]) / extent[axis] * gridSize;
+        return static_cast<uint32_t>(std::clamp(cell, 0.0, static_cast<double>(gridSize - 1)));
+    };
+
+    std::vector<uint32_t> remap(positions.size());
+    std::unordered_map<uint32_t, uint32_t> cellVertices;
+    for (size_t vertIdx = 0; vertIdx < positions.size(); ++vertIdx) {
+        vec3f const& pos = positions[vertIdx];
+        uint32_t cell = cellOf(pos.x, 0) + gridSize * (cellOf(pos.y, 1) + gridSize * cellOf(pos.z, 2));
+        remap[vertIdx] = cellVertices.emplace(cell, static_cast<uint32_t>(vertIdx)).first->second;
+    }
+    return remap;
+}
+
+std::vector<uint32_t> buildLodChain(std::span<uint32_t const> indices, std::span<vec3f const> positions, Bounds const& bounds,
+                                    std::vector<LodLevel>& levels) {
+    GAME_ASSERT(indices.size() % 3 == 0);
+    std::vector<uint32_t> chain(indices.begin(), indices.end());
+    levels.assign(1, {0, static_cast<uint32_t>(indices.size())});
+
+    for (uint32_t gridSize: LodGridSizes) {
+        if (levels.size() == MaxLodLevels) break;
+
+        std::vector<uint32_t> remap = clusterVertices(positions, bounds, gridSize);
+        LodLevel const& previous = levels.back();
+        size_t levelStart = chain.size();
+        for (size_t i = previous.firstIndex; i < previous.firstIndex + previous.indexCount; i += 3) {
+            uint32_t a = remap[chain[i]], b = remap[chain[i + 1]], c = remap[chain[i + 2]];
+            if (a == b || b == c || c == a) continue;
+
+            chain.insert(chain.end(), {a, b, c});
+        }
+        auto indexCount = static_cast<uint32_t>(chain.size() - levelStart);
+        if (indexCount == 0 || indexCount > previous.indexCount * MinLodReduction) {
+            chain.resize(levelStart);
+            continue;
+        }
+        levels.push_back({static_cast<uint32_t>(levelStart), indexCount});
+    }
+    return chain;
+}
+
+double calcScreenSize(scalar radius, scalar distance, double focalLength) {
+    // Inside the sphere it covers the whole screen
+    if (distance <= radius) return std::numeric_limits<double>::max();
+
+    return radius * focalLength / distance;
+}
+
+uint32_t selectLod(uint32_t currentLevel, uint32_t levelCount, double screenSize) {
+    uint32_t level = std::min(currentLevel, levelCount - 1);
+    while (level + 1 < levelCount && screenSize < LodScreenSizes[level] * (1.0 - LodHysteresis)) level++;
+    while (level > 0 && screenSize > LodScreenSizes[level - 1] * (1.0 + LodHysteresis)) level--;
+    return level;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "game_pch.hpp"
+
+#include <span>
+
+#include "assets.hpp"
+
+constexpr uint32_t MaxLodLevels = 4;
+
+/** @brief Range of a model's index buffer drawn at one detail level */
+struct LodLevel {
+    uint32_t firstIndex, indexCount;
+};
+
+/**
+ * @brief Builds coarser index lists over the same vertices, so every level shares the model's vertex buffer.
+ *
+ * Vertices are snapped to ever coarser grids over the model bounds and triangles that collapse are dropped.
+ * A level is only kept when it removes a good share of the triangles of the level before it.
+ *
+ * @param levels    Filled with where each level is in the returned indices, the first level is the given indices unchanged
+ * @return          Indices of every level one after the other
+ */
+std::vector<uint32_t> buildLodChain(std::span<uint32_t const> indices, std::span<vec3f const> positions, Bounds const& bounds,
+                                    std::vector<LodLevel>& levels);
+
+/**
+ * @brief How large a model appears, as its projected bounding sphere radius over half the screen height.
+ * @param focalLength   Vertical scale of the projection, which is proj[1][1] of calcProj
+ */
+double calcScreenSize(scalar radius, scalar distance, double focalLength);
+
+/** @brief Picks the level for a screen size, only leaving the current level once past a margin around its thresholds so models do not pop back and forth */
+uint32_t selectLod(uint32_t currentLevel, uint32_t levelCount, double screenSize);
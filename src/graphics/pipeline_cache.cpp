@@ -0,0 +1,116 @@
+#include "pipeline_cache.hpp"
+
+#include "hash.hpp"
+
+constexpr uint32_t PipelineCacheMagic = 0x51504343; // "QPCC"
+
+// Written in front of the driver's blob so we can reject files from other drivers before handing them over
+struct PipelineCacheFileHeader {
+    uint32_t magic;
+    uint32_t vendorId, deviceId, driverVersion;
+    std::array<uint8_t, VK_UUID_SIZE> pipelineCacheUuid;
+    uint64_t dataSize, dataHash;
+};
+
+std::string_view asBytes(void const* data, size_t size) {
+    return {static_cast<char const*>(data), size};
+}
+
+PipelineCacheFileHeader makeHeader(vk::PhysicalDeviceProperties const& props) {
+    PipelineCacheFileHeader header{
+            .magic = PipelineCacheMagic,
+            .vendorId = props.vendorID,
+            .deviceId = props.deviceID,
+            .driverVersion = props.driverVersion,
+            .pipelineCacheUuid = {},
+            .dataSize = 0,
+            .dataHash = 0,
+    };
+    std::copy(props.pipelineCacheUUID.begin(), props.pipelineCacheUUID.end(), header.pipelineCacheUuid.begin());
+    return header;
+}
+
+std::filesystem::path pipelineCachePath(vk::PhysicalDeviceProperties const& props) {
+    // Keyed by device so machines with multiple GPUs do not keep throwing away each other's caches
+    uint64_t key = fnv1a64(asBytes(props.pipelineCacheUUID.data(), VK_UUID_SIZE));
+    key = fnv1a64(asBytes(&props.driverVersion, sizeof(props.driverVersion)), key);
+    std::stringstream name;
+    name << "pipelines-" << std::hex << std::setw(16) << std::setfill('0') << key << ".bin";
+    return std::filesystem::current_path() / "cache" / name.str();
+}
+
+// Validates the header the driver puts in front of its own data, which is laid out by the spec
+bool isDriverHeaderValid(std::vector<std::byte> const& data, vk::PhysicalDeviceProperties const& props) {
+    if (data.size() < sizeof(VkPipelineCacheHeaderVersionOne)) return false;
+
+    VkPipelineCacheHeaderVersionOne header;
+    std::memcpy(&header, data.data(), sizeof(header));
+    return header.headerSize >= sizeof(header) &&
+           header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+           header.vendorID == props.vendorID &&
+           header.deviceID == props.deviceID &&
+           std::equal(props.pipelineCacheUUID.begin(), props.pipelineCacheUUID.end(), header.pipelineCacheUUID);
+}
+
+std::vector<std::byte> readPipelineCache(vk::PhysicalDeviceProperties const& props) {
+    std::filesystem::path path = pipelineCachePath(props);
+    std::ifstream file(path, std::ios::binary);
+    if (!file) return {};
+
+    PipelineCacheFileHeader header{}, expected = makeHeader(props);
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!file || header.magic != expected.magic || header.vendorId != expected.vendorId || header.deviceId != expected.deviceId ||
+        header.driverVersion != expected.driverVersion || header.pipelineCacheUuid != expected.pipelineCacheUuid) {
+        std::cerr << "[Vulkan] Pipeline cache " << path << " is for a different device or driver, ignoring" << std::endl;
+        return {};
+    }
+
+    // Check the size against the file before allocating, a corrupt header must not be able to ask for gigabytes
+    std::error_code err;
+    uintmax_t fileSize = std::filesystem::file_size(path, err);
+    if (err || fileSize < sizeof(header) || header.dataSize != fileSize - sizeof(header)) {
+        std::cerr << "[Vulkan] Pipeline cache " << path << " is truncated or corrupt, ignoring" << std::endl;
+        return {};
+    }
+
+    std::vector<std::byte> data(header.dataSize);
+    file.read(reinterpret_cast<char*>(data.data()), static_cast<std::streamsize>(data.size()));
+    if (!file || fnv1a64(asBytes(data.data(), data.size())) != header.dataHash || !isDriverHeaderValid(data, props)) {
+        std::cerr << "[Vulkan] Pipeline cache " << path << " is corrupt, ignoring" << std::endl;
+        return {};
+    }
+    return data;
+}
+
+vk::raii::PipelineCache loadPipelineCache(vk::raii::Device const& device, vk::PhysicalDeviceProperties const& props) {
+    std::vector<std::byte> data = readPipelineCache(props);
+    std::cout << "[Vulkan] Loaded " << data.size() << " bytes of pipeline cache" << std::endl;
+    return {device, vk::PipelineCacheCreateInfo({}, data.size(), data.data())};
+}
+
+void savePipelineCache(vk::raii::PipelineCache const& cache, vk::PhysicalDeviceProperties const& props) {
+    std::vector<uint8_t> data = cache.getData();
+    PipelineCacheFileHeader header = makeHeader(props);
+    header.dataSize = data.size();
+    header.dataHash = fnv1a64(asBytes(data.data(), data.size()));
+
+    std::filesystem::path path = pipelineCachePath(props);
+    std::error_code err;
+    std::filesystem::create_directories(path.parent_path(), err);
+    // Write to the side and rename so a crash never leaves a truncated cache behind
+    std::filesystem::path tmpPath = path;
+    tmpPath += ".tmp";
+    {
+        std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<char const*>(&header), sizeof(header));
+        file.write(reinterpret_cast<char const*>(data.data()), static_cast<std::streamsize>(data.size()));
+        if (!file) {
+            std::cerr << "[Vulkan] Failed to write pipeline cache " << path << std::endl;
+            return;
+        }
+    }
+    std::filesystem::rename(tmpPath, path, err);
+    if (err) {
+        std::cerr << "[Vulkan] Failed to write pipeline cache " << path << ": " << err.message() << std::endl;
+    }
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "game_pch.hpp"
+
+#include <vulkan/vulkan_raii.hpp>
+
+struct PipelineCacheStats {
+    uint32_t hits{}, misses{};
+    // Creation feedback is an extension, without it nothing is counted
+    bool isSupported = false;
+};
+
+/**
+ * @brief Creates a pipeline cache seeded from disk when there is a file matching this device and driver.
+ *        Anything that fails validation is ignored and an empty cache is created instead.
+ */
+vk::raii::PipelineCache loadPipelineCache(vk::raii::Device const& device, vk::PhysicalDeviceProperties const& props);
+
+void savePipelineCache(vk::raii::PipelineCache const& cache, vk::PhysicalDeviceProperties const& props);
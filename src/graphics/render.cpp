@@ -9,7 +9,13 @@
 #include "shader_math.hpp"
 
 void VulkanRenderPlugin::build(App& app) {
-    app.globalCtx.emplace<VulkanContext>();
+    auto& vk = app.globalCtx.emplace<VulkanContext>();
+    vk.framesInFlight = std::max(mFramesInFlight, 1u);
+    vk.cullingMode = mCullingMode;
+    vk.recordThreadCount = static_cast<uint32_t>(app.threadPool.size() + 1);
+    for (size_t i = 0; i < app.renderWorlds.size(); ++i) {
+        vk.drawTrackers[i].connect(app.renderWorlds[i]);
+    }
     app.globalCtx.emplace<WindowContext>(false, true, false);
 }
 
@@ -30,7 +36,8 @@ void setupImgui(VulkanContext& vk) {
             .DescriptorPool = static_cast<VkDescriptorPool>(**vk.descriptorPool),
             .Subpass = 0,
             .MinImageCount = 2,
-            .ImageCount = 2,
+            // ImGui keeps vertex and index buffers per image, so we need at least one per frame in flight
+            .ImageCount = std::max({2u, vk.framesInFlight, static_cast<uint32_t>(vk.swapChainData->images.size())}),
             .MSAASamples = VK_SAMPLE_COUNT_1_BIT,
             .Allocator = nullptr,
             .CheckVkResultFn = nullptr
@@ -38,13 +45,22 @@ void setupImgui(VulkanContext& vk) {
     ImGui_ImplVulkan_Init(&init_info, static_cast<VkRenderPass>(**vk.renderPass));
     std::cout << "[IMGUI] " << IMGUI_VERSION << " initialized" << std::endl;
 
-    vk::raii::su::oneTimeSubmit(vk.cmdBufs->front(), *vk.graphicsQueue, [](vk::raii::CommandBuffer const& cmdBuf) {
+    vk::raii::su::oneTimeSubmit(*vk.device, *vk.cmdPool, *vk.graphicsQueue, [](vk::raii::CommandBuffer const& cmdBuf) {
         ImGui_ImplVulkan_CreateFontsTexture(static_cast<VkCommandBuffer>(*cmdBuf));
     });
 
     ImGui_ImplVulkan_DestroyFontUploadObjects();
 }
 
+constexpr vk::DeviceSize UploadBufferCapacity = 64 * 1024;
+
+RecordingSlot makeRecordingSlot(vk::raii::Device const& device, uint32_t queueFamilyIdx) {
+    // Buffers are never reset one by one, the whole pool is reset at the start of the frame instead
+    vk::raii::CommandPool pool(device, {vk::CommandPoolCreateFlagBits::eTransient, queueFamilyIdx});
+    vk::raii::CommandBuffers cmdBufs(device, {*pool, vk::CommandBufferLevel::eSecondary, 1});
+    return {std::move(pool), std::move(cmdBufs.front())};
+}
+
 void init(VulkanContext& vk) {
     std::string const appName = "Game Engine", engineName = "QEngine";
     vk.inst = vk::raii::su::makeInstance(vk.ctx, appName, engineName, {}, vk::su::getInstanceExtensions());
@@ -74,21 +90,57 @@ void init(VulkanContext& vk) {
     std::tie(vk.graphicsFamilyIdx, vk.graphicsFamilyIdx) = vk::raii::su::findGraphicsAndPresentQueueFamilyIndex(*vk.physDev, *vk.surfData->surface);
 
     std::vector<std::string> extensions = vk::su::getDeviceExtensions();
+    for (vk::ExtensionProperties const& extProps: vk.physDev->enumerateDeviceExtensionProperties()) {
+        if (std::string_view(extProps.extensionName) == VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME) {
+            extensions.emplace_back(VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME);
+            vk.pipelineCacheStats.isSupported = true;
+        }
+    }
 //#if !defined(NDEBUG)
 //    extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
 //#endif
-    vk.device = vk::raii::su::makeDevice(*vk.physDev, vk.graphicsFamilyIdx, extensions);
+    // Only features that are optional for us are turned on, and only where supported
+    vk::PhysicalDeviceFeatures supportedFeatures = vk.physDev->getFeatures(), features;
+    features.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+    // Culled buckets are drawn with their first instance in the indirect command, which is an optional feature
+    features.drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance;
+    if (vk.cullingMode == CullingMode::Gpu && !features.drawIndirectFirstInstance) {
+        std::cerr << "[Vulkan] Indirect draws cannot start past the first instance, culling on the CPU instead" << std::endl;
+        vk.cullingMode = CullingMode::Cpu;
+    }
+    vk.device = vk::raii::su::makeDevice(*vk.physDev, vk.graphicsFamilyIdx, extensions, &features);
+    if (features.multiDrawIndirect) vk.maxMultiDrawCount = props.limits.maxDrawIndirectCount;
 
     vk.cmdPool = vk::raii::CommandPool(*vk.device, {vk::CommandPoolCreateFlagBits::eResetCommandBuffer, vk.graphicsFamilyIdx});
-    vk.cmdBufs = vk::raii::CommandBuffers(*vk.device, {**vk.cmdPool, vk::CommandBufferLevel::ePrimary, 2});
+    vk.cmdBufs = vk::raii::CommandBuffers(*vk.device, {**vk.cmdPool, vk::CommandBufferLevel::ePrimary, vk.framesInFlight});
 
     vk.graphicsQueue = vk::raii::Queue(*vk.device, vk.graphicsFamilyIdx, 0);
     vk.presentQueue = vk::raii::Queue(*vk.device, vk.presentFamilyIdx, 0);
 
-    vk.drawFence = vk::raii::Fence(*vk.device, vk::FenceCreateInfo());
-    vk.imgAcqSem = vk::raii::Semaphore(*vk.device, vk::SemaphoreCreateInfo());
+    // Uniform and storage buffers share the upload buffer, both alignments are powers of two so the larger satisfies both
+    vk::DeviceSize uploadAlignment = std::max(props.limits.minUniformBufferOffsetAlignment, props.limits.minStorageBufferOffsetAlignment);
+    vk.frames.reserve(vk.framesInFlight);
+    for (uint32_t i = 0; i < vk.framesInFlight; ++i) {
+        // Fences start signaled so the first wait on each frame returns immediately
+        vk.frames.push_back(FrameData{
+                vk::raii::Fence(*vk.device, vk::FenceCreateInfo(vk::FenceCreateFlagBits::eSignaled)),
+                vk::raii::Semaphore(*vk.device, vk::SemaphoreCreateInfo()),
+                UploadBuffer(*vk.physDev, *vk.device, UploadBufferCapacity, uploadAlignment,
+                             // Culling on the GPU writes indirect draws into the upload buffer as well
+                             vk::BufferUsageFlagBits::eUniformBuffer | vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer)
+        });
+        FrameData& frame = vk.frames.back();
+        frame.drawSlots.reserve(vk.recordThreadCount);
+        for (uint32_t j = 0; j < vk.recordThreadCount; ++j) {
+            frame.drawSlots.push_back(makeRecordingSlot(*vk.device, vk.graphicsFamilyIdx));
+        }
+        frame.uiSlot = makeRecordingSlot(*vk.device, vk.graphicsFamilyIdx);
+    }
 
-    vk.pipelineCache = vk::raii::PipelineCache(*vk.device, vk::PipelineCacheCreateInfo());
+    vk.pipelineCache = loadPipelineCache(*vk.device, props);
+
+    vk.vertexGeometry.emplace(VertexBlockSize, vk::BufferUsageFlagBits::eVertexBuffer);
+    vk.indexGeometry.emplace(IndexBlockSize, vk::BufferUsageFlagBits::eIndexBuffer);
 
     vk.descriptorPool = vk::raii::su::makeDescriptorPool(
             *vk.device, {
@@ -108,40 +160,85 @@ void init(VulkanContext& vk) {
 
     createSwapChain(vk);
 
+    if (vk.cullingMode == CullingMode::Gpu) createCullPipeline(vk);
+
     setupImgui(vk);
 
     glslang::InitializeProcess();
 }
 
-void VulkanRenderPlugin::execute(App& app) {
+void VulkanRenderPlugin::access(SystemAccess& access) {
+    // Model streaming goes through the asset cache, which nothing else touches yet
+    access.mainThread()
+            .read<FrontRenderWorldAccess, WindowContext>()
+            .write<VulkanContext, ModelAssets>();
+}
+
+void VulkanRenderPlugin::sync(App& app) {
     auto pVk = app.globalCtx.find<VulkanContext>();
     if (!pVk) return;
 
     VulkanContext& vk = *pVk;
     if (!vk.inst) init(vk);
 
-    // Acquire next image and signal the semaphore
-    auto [acqResult, curBuf] = vk.swapChainData->swapChain->acquireNextImage(vk::su::FenceTimeout, **vk.imgAcqSem, nullptr);
+    glfwPollEvents();
+    bool& keepOpen = app.globalCtx.at<WindowContext>().keepOpen;
+    keepOpen = !glfwWindowShouldClose(vk.surfData->window.handle);
+    if (!keepOpen) {
+        vk.device->waitIdle();
+        return;
+    }
 
-    if (acqResult == vk::Result::eSuboptimalKHR) {
-        recreatePipeline(vk);
+    buildImGui(app);
+}
+
+void VulkanRenderPlugin::execute(App& app) {
+    auto pVk = app.globalCtx.find<VulkanContext>();
+    if (!pVk || !pVk->inst || !app.globalCtx.at<WindowContext>().keepOpen) return;
+
+    VulkanContext& vk = *pVk;
+
+    FrameData& frame = vk.frames[vk.frameIdx];
+    vk::raii::CommandBuffer const& cmdBuf = (*vk.cmdBufs)[vk.frameIdx];
+
+    // Wait until the GPU has finished the last submission that used this frame's command buffer and uniforms
+    while (vk::Result::eTimeout == vk.device->waitForFences(*frame.drawFence, VK_TRUE, vk::su::FenceTimeout));
+    // The GPU is done reading last round's uniforms, so we can overwrite them
+    frame.uploads.reset();
+    frame.stagingBufs.clear();
+    for (RecordingSlot& slot: frame.drawSlots) slot.pool.reset();
+    frame.uiSlot->pool.reset();
+
+    // Acquire next image and signal the semaphore
+    vk::Result acqResult;
+    uint32_t curBuf;
+    try {
+        std::tie(acqResult, curBuf) = vk.swapChainData->swapChain->acquireNextImage(vk::su::FenceTimeout, *frame.imgAcqSem, nullptr);
+    } catch (vk::OutOfDateKHRError const&) {
+        recreateSwapChain(vk);
         return;
     }
-    if (acqResult != vk::Result::eSuccess) {
+    // Suboptimal still signals the semaphore, so render this frame and recreate after presenting
+    if (acqResult != vk::Result::eSuccess && acqResult != vk::Result::eSuboptimalKHR) {
         throw std::runtime_error("Invalid acquire next image KHR result");
     }
     if (vk.framebufs.size() <= curBuf) {
         throw std::runtime_error("Invalid framebuffer size");
     }
 
-    for (auto [ent, shaderHandle]: app.renderWorld.view<const ShaderHandle>().each()) {
+    for (auto [ent, shaderHandle]: app.renderWorld().view<const ShaderHandle>().each()) {
         if (vk.modelPipelines.contains(shaderHandle.value)) continue;
 
         // Create blank shader and fill it in
-        createShaderPipeline(vk, vk.modelPipelines[shaderHandle.value]);
+        Pipeline& pipeline = vk.modelPipelines[shaderHandle.value];
+        pipeline.sortIdx = static_cast<uint32_t>(vk.modelPipelines.size() - 1);
+        createShaderPipeline(vk, pipeline);
     }
 
-    vk.cmdBufs->front().begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlags()));
+    cmdBuf.begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlags()));
+    // Transfers and dispatches are not allowed inside a render pass
+    uploadModels(app, cmdBuf);
+    prepareOpaque(app, cmdBuf);
     vk::ClearValue clearColor = vk::ClearColorValue(std::array<float, 4>{0.2f, 0.2f, 0.2f, 0.2f});
     vk::ClearValue clearDepth = vk::ClearDepthStencilValue(1.0f, 0);
     std::array<vk::ClearValue, 2> clearVals{clearColor, clearDepth};
@@ -151,24 +248,26 @@ void VulkanRenderPlugin::execute(App& app) {
             vk::Rect2D({}, vk.surfData->extent),
             clearVals
     );
-    vk.cmdBufs->front().beginRenderPass(renderPassBeginInfo, vk::SubpassContents::eInline);
-    renderOpaque(app);
-    renderImGui(app);
-    vk.cmdBufs->front().endRenderPass();
-    vk.cmdBufs->front().end();
+    // Everything inside the render pass is recorded into secondaries, possibly on other threads
+    cmdBuf.beginRenderPass(renderPassBeginInfo, vk::SubpassContents::eSecondaryCommandBuffers);
+    vk::CommandBufferInheritanceInfo inheritance(**vk.renderPass, 0, *vk.framebufs[curBuf]);
+    std::vector<vk::CommandBuffer> recorded;
+    renderOpaque(app, inheritance, recorded);
+    renderImGui(app, inheritance, recorded);
+    cmdBuf.executeCommands(recorded);
+    cmdBuf.endRenderPass();
+    cmdBuf.end();
 
     vk::PipelineStageFlags waitDestStageMask(vk::PipelineStageFlagBits::eColorAttachmentOutput);
-    // Fences need to be manually reset
-    vk.device->resetFences(**vk.drawFence);
-    // Wait for the image to be acquired via the semaphore, signal the drawing fence when submitted
-    vk.graphicsQueue->submit(vk::SubmitInfo(**vk.imgAcqSem, waitDestStageMask, *vk.cmdBufs->front()), **vk.drawFence);
-
-    // Wait for the draw fence to be signaled
-    while (vk::Result::eTimeout == vk.device->waitForFences(**vk.drawFence, VK_TRUE, vk::su::FenceTimeout));
+    // Fences need to be manually reset, only do so once we know we are going to submit work that signals it
+    vk.device->resetFences(*frame.drawFence);
+    // Wait for the image to be acquired via the semaphore, signal the drawing fence when done
+    // We do not wait on the fence here, that happens the next time this frame comes around
+    vk.graphicsQueue->submit(vk::SubmitInfo(*frame.imgAcqSem, waitDestStageMask, *cmdBuf, *vk.renderDoneSems[curBuf]), *frame.drawFence);
 
     try {
-        // Present frame to display
-        vk::Result result = vk.presentQueue->presentKHR({nullptr, **vk.swapChainData->swapChain, curBuf});
+        // Present frame to display once rendering has finished
+        vk::Result result = vk.presentQueue->presentKHR({*vk.renderDoneSems[curBuf], **vk.swapChainData->swapChain, curBuf});
         switch (result) {
             case vk::Result::eSuccess:
             case vk::Result::eSuboptimalKHR:
@@ -176,22 +275,27 @@ void VulkanRenderPlugin::execute(App& app) {
             default:
                 throw std::runtime_error("Bad present KHR result: " + vk::to_string(result));
         }
+        if (acqResult == vk::Result::eSuboptimalKHR) {
+            recreateSwapChain(vk);
+        }
     } catch (vk::OutOfDateKHRError const&) {
-        recreatePipeline(vk);
+        recreateSwapChain(vk);
     }
 
-    glfwPollEvents();
-    bool& keepOpen = app.globalCtx.at<WindowContext>().keepOpen;
-    keepOpen = !glfwWindowShouldClose(vk.surfData->window.handle);
-    if (!keepOpen) {
-        vk.device->waitIdle();
-    }
+    vk.frameIdx = (vk.frameIdx + 1) % vk.framesInFlight;
 }
 
 void VulkanRenderPlugin::cleanup(App& app) {
+    auto& vk = app.globalCtx.at<VulkanContext>();
+    for (size_t i = 0; i < app.renderWorlds.size(); ++i) {
+        vk.drawTrackers[i].disconnect(app.renderWorlds[i]);
+    }
+    if (vk.pipelineCache) {
+        savePipelineCache(*vk.pipelineCache, vk.physDev->getProperties());
+    }
     ImGui_ImplVulkan_Shutdown();
     glslang::FinalizeProcess();
-    for (auto& [_, pipeline]: app.globalCtx.at<VulkanContext>().modelPipelines) {
+    for (auto& [_, pipeline]: vk.modelPipelines) {
         for (auto& item: pipeline.shaders) {
             spvReflectDestroyShaderModule(&item.reflect);
         }
@@ -0,0 +1,59 @@
+#include "render.hpp"
+
+#include "shader_cache.hpp"
+
+// Has to match the local size in the shader
+constexpr uint32_t CullGroupSize = 64;
+
+void createCullPipeline(VulkanContext& vk) {
+    CullPipeline& cull = vk.cullPipeline;
+    std::array<vk::DescriptorSetLayoutBinding, 5> bindings{
+            vk::DescriptorSetLayoutBinding{0, vk::DescriptorType::eUniformBuffer, 1, vk::ShaderStageFlagBits::eCompute},
+            vk::DescriptorSetLayoutBinding{1, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute},
+            vk::DescriptorSetLayoutBinding{2, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute},
+            vk::DescriptorSetLayoutBinding{3, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute},
+            vk::DescriptorSetLayoutBinding{4, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute},
+    };
+    cull.descSetLayout = vk::raii::DescriptorSetLayout(*vk.device, vk::DescriptorSetLayoutCreateInfo{{}, bindings});
+    vk::DescriptorSetLayout descSetLayout = **cull.descSetLayout;
+    cull.layout = vk::raii::PipelineLayout(*vk.device, vk::PipelineLayoutCreateInfo{{}, descSetLayout, {}});
+
+    auto shaderPath = std::filesystem::current_path() / "assets" / "shaders" / "cull.comp";
+    std::vector<uint32_t> shaderSpv = loadOrCompileSpirv(vk::ShaderStageFlagBits::eCompute, shaderPath);
+    vk::raii::ShaderModule module(*vk.device, vk::ShaderModuleCreateInfo({}, shaderSpv));
+    vk::PipelineShaderStageCreateInfo stage({}, vk::ShaderStageFlagBits::eCompute, *module, "main");
+    cull.value = vk::raii::Pipeline(*vk.device, *vk.pipelineCache, vk::ComputePipelineCreateInfo({}, stage, **cull.layout));
+
+    std::vector<vk::DescriptorSetLayout> layouts(vk.framesInFlight, descSetLayout);
+    cull.descSets = vk::raii::DescriptorSets(*vk.device, {**vk.descriptorPool, layouts});
+}
+
+void dispatchCull(VulkanContext& vk, vk::raii::CommandBuffer const& cmdBuf, CullRegions const& regions) {
+    CullPipeline const& cull = vk.cullPipeline;
+    vk::Buffer uploads = vk.frames[vk.frameIdx].uploads.buffer();
+    vk::DescriptorSet descSet = *cull.descSets[vk.frameIdx];
+
+    // The regions move every frame, but this frame's set is not in use anymore once its fence has signaled
+    std::array<vk::DescriptorBufferInfo, 5> bufInfos{
+            vk::DescriptorBufferInfo{uploads, regions.cull, sizeof(CullUpload)},
+            vk::DescriptorBufferInfo{uploads, regions.spheres, sizeof(vec4f) * regions.instanceCount},
+            vk::DescriptorBufferInfo{uploads, regions.instanceBuckets, sizeof(uint32_t) * regions.instanceCount},
+            vk::DescriptorBufferInfo{uploads, regions.bucketCommands, sizeof(vk::DrawIndexedIndirectCommand) * regions.bucketCount},
+            vk::DescriptorBufferInfo{uploads, regions.instanceIndices, sizeof(uint32_t) * regions.instanceCount},
+    };
+    std::array<vk::WriteDescriptorSet, 5> writes;
+    for (uint32_t binding = 0; binding < writes.size(); ++binding) {
+        vk::DescriptorType type = binding == 0 ? vk::DescriptorType::eUniformBuffer : vk::DescriptorType::eStorageBuffer;
+        writes[binding] = vk::WriteDescriptorSet(descSet, binding, 0, 1, type, nullptr, &bufInfos[binding]);
+    }
+    vk.device->updateDescriptorSets(writes, nullptr);
+
+    cmdBuf.bindPipeline(vk::PipelineBindPoint::eCompute, **cull.value);
+    cmdBuf.bindDescriptorSets(vk::PipelineBindPoint::eCompute, **cull.layout, 0u, descSet, nullptr);
+    cmdBuf.dispatch((regions.instanceCount + CullGroupSize - 1) / CullGroupSize, 1, 1);
+
+    // Draw commands are read at the indirect stage, the instance indices by the vertex shader
+    cmdBuf.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eDrawIndirect | vk::PipelineStageFlagBits::eVertexShader, {},
+                           vk::MemoryBarrier(vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eIndirectCommandRead | vk::AccessFlagBits::eShaderRead),
+                           nullptr, nullptr);
+}
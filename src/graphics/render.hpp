@@ -9,19 +9,69 @@
 #include "state.hpp"
 #include "plugin.hpp"
 #include "matrix4x4.hpp"
-#include "collections/aligned_vector.hpp"
 #include "utils_raii.hpp"
 #include "cubemap.hpp"
+#include "culling.hpp"
+#include "lod.hpp"
+#include "upload_buffer.hpp"
+#include "geometry_buffer.hpp"
+#include "pipeline_cache.hpp"
 
-const std::unordered_set<std::string_view> DynamicNames{"model"sv, "material"sv};
+enum class DynamicUniform {
+    Camera, Scene, Instances, Materials, InstanceIndices, Count
+};
+
+// Every uniform is written each frame into the frame's upload buffer, so they are all bound as dynamic
+const std::unordered_map<std::string_view, DynamicUniform> DynamicNames{
+        {"camera"sv,    DynamicUniform::Camera},
+        {"scene"sv,     DynamicUniform::Scene},
+        {"instances"sv, DynamicUniform::Instances},
+        {"materials"sv, DynamicUniform::Materials},
+        {"instanceIndices"sv, DynamicUniform::InstanceIndices},
+};
+
+// Uploading a model is not free either, so only this many are copied to the GPU per frame
+constexpr size_t MaxModelUploadsPerFrame = 4;
+
+// Every model's geometry shares blocks of this size, so the renderer can bind once and draw many
+constexpr vk::DeviceSize VertexBlockSize = 64ull << 20, IndexBlockSize = 32ull << 20;
+
+using DynamicOffsets = std::array<uint32_t, static_cast<size_t>(DynamicUniform::Count)>;
+
+enum class CullingMode {
+    // Instances are tested against the frustum on the CPU and only visible ones are uploaded and drawn
+    Cpu,
+    // Everything the spatial index lets through is uploaded and a compute dispatch fills in the draws
+    Gpu
+};
 
 class VulkanRenderPlugin : public Plugin {
 public:
+    /**
+     * @param framesInFlight    How many frames the CPU may record ahead of the GPU.
+     *                          One means the CPU waits for each frame to finish before starting the next.
+     */
+    explicit VulkanRenderPlugin(uint32_t framesInFlight = 2, CullingMode cullingMode = CullingMode::Gpu)
+            : mFramesInFlight(framesInFlight), mCullingMode(cullingMode) {}
+
     void build(App& app) override;
 
+    void access(SystemAccess& access) override;
+
+    /**
+     * @brief Main thread work that must not overlap with the simulation.
+     *        Polls window events and builds the UI, which reads the logic world.
+     */
+    void sync(App& app);
+
+    /** @brief Records and submits a frame from the render world, safe to run while the simulation extracts into the other one */
     void execute(App& app) override;
 
     void cleanup(App& app) override;
+
+private:
+    uint32_t mFramesInFlight;
+    CullingMode mCullingMode;
 };
 
 struct WindowContext {
@@ -32,10 +82,6 @@ struct mat4f {
     std::array<std::array<float, 4>, 4> col;
 };
 
-enum class PBRWorkflows {
-    MetallicRoughness = 0, SpecularGlossiness = 1
-};
-
 struct CameraUpload {
     mat4f view, proj, clip;
     vec3f camPos;
@@ -45,6 +91,11 @@ struct ModelUpload {
     mat4f matrix;
 };
 
+// std430 rounds the array stride of a struct up to its largest member, which is a vec4 here
+struct alignas(16) MaterialUpload {
+    Material material;
+};
+
 struct SceneUpload {
     vec4f lightDir;
     float exposure;
@@ -55,16 +106,71 @@ struct SceneUpload {
     float debugViewEquation;
 };
 
+/** @brief Where a model's flattened geometry lives in the shared geometry blocks */
 struct ModelBuffers {
-    vk::raii::su::BufferData indexBufData;
-    vk::raii::su::BufferData vertBufData;
+    GeometryAllocation vertices, indices;
+    // First vertex of the model in its block, counted in vertices of the stride it was uploaded with
+    int32_t vertexOffset;
+    // Most detailed first, ranges of the block's indices that already include where the model starts
+    std::vector<LodLevel> lods;
+    Bounds bounds;
+    // Dense index for draw sort keys, models are never unloaded so it stays unique
+    uint32_t sortIdx;
+};
+
+/**
+ * @brief Orders draws so that state only changes where it has to: by pipeline, then by mesh, then front to back.
+ *        Materials are per instance data rather than bound state, so they do not need any bits.
+ */
+using DrawKey = uint64_t;
+
+struct DrawInstance {
+    DrawKey key;
+    // Index of the pipeline's binding for this frame, which is also its sort index
+    uint32_t bindingIdx;
+    ModelBuffers const* buffers;
+    uint32_t lod;
+    entt::entity ent;
+    // Interpolated, so it only has to be worked out once per frame
+    Position pos;
+};
+
+/** @brief A run of sorted draw instances sharing a pipeline, a model and its detail level, which is one instanced draw */
+struct DrawBucket {
+    uint32_t bindingIdx;
+    ModelBuffers const* buffers;
+    uint32_t lod;
+    uint32_t first, count;
+};
+
+// std140, the planes come first so the counts need no padding
+struct CullUpload {
+    std::array<vec4f, 6> planes;
+    uint32_t instanceCount;
+    uint32_t bucketCount;
+};
+
+/** @brief Offsets of what the cull dispatch reads and writes in the frame's upload buffer */
+struct CullRegions {
+    uint32_t cull, spheres, instanceBuckets, bucketCommands, instanceIndices;
+    uint32_t instanceCount, bucketCount;
+};
+
+struct CullPipeline {
+    std::optional<vk::raii::DescriptorSetLayout> descSetLayout;
+    std::optional<vk::raii::PipelineLayout> layout;
+    std::optional<vk::raii::Pipeline> value;
+    // One per frame in flight, rewritten every frame since the regions move around in the upload buffer
+    std::vector<vk::raii::DescriptorSet> descSets;
 };
 
 struct VertexAttr {
     std::string name;
     vk::Format format;
+    // Bytes taken up in the vertex buffer, which may be more than the shader reads
     uint32_t size;
     uint32_t offset;
+    uint32_t compCount;
 };
 
 struct Shader {
@@ -78,13 +184,74 @@ struct Shader {
     SpvReflectInterfaceVariable** inputsReflect = nullptr;
 };
 
+/** @brief Resources a pipeline writes every frame, so each frame in flight needs its own copy */
+struct PipelineFrame {
+    std::vector<vk::raii::DescriptorSet> descSets;
+    // Generation of the upload buffer the dynamic descriptors were last written for
+    uint32_t uploadGeneration{};
+};
+
+struct DynamicBinding {
+    uint32_t set, binding;
+    vk::DescriptorType type;
+    DynamicUniform uniform;
+};
+
 struct Pipeline {
     std::vector<Shader> shaders;
     std::optional<vk::raii::Pipeline> value;
     std::optional<vk::raii::PipelineLayout> layout;
     std::vector<vk::raii::DescriptorSetLayout> descSetLayouts;
-    std::vector<vk::raii::DescriptorSet> descSets;
-    std::map<std::pair<uint32_t, uint32_t>, vk::raii::su::BufferData> uniforms;
+    std::vector<PipelineFrame> frames;
+    // Sorted by set then by binding, which is the order Vulkan expects dynamic offsets in
+    std::vector<DynamicBinding> dynamicBindings;
+    // Dense index for draw sort keys, handed out in creation order
+    uint32_t sortIdx{};
+};
+
+/** @brief How the draws of one pipeline are bound this frame, gathered up front so recording threads share them read only */
+struct PipelineBinding {
+    Pipeline const* pipeline;
+    std::vector<vk::DescriptorSet> descSets{};
+    std::vector<uint32_t> dynamicOffsets{};
+};
+
+/** @brief A secondary command buffer with a pool of its own, so it can be recorded on any thread without locking */
+struct RecordingSlot {
+    vk::raii::CommandPool pool;
+    vk::raii::CommandBuffer cmdBuf;
+};
+
+/** @brief What recording draws bound, a naive renderer binds both a pipeline and geometry for every draw */
+struct BindCounts {
+    size_t draws{}, pipelineBinds{}, geometryBinds{};
+    // Multi draw indirect issues several draws per call
+    size_t calls{};
+
+    BindCounts& operator+=(BindCounts const& other) {
+        draws += other.draws;
+        calls += other.calls;
+        pipelineBinds += other.pipelineBinds;
+        geometryBinds += other.geometryBinds;
+        return *this;
+    }
+};
+
+struct RenderStats {
+    size_t visibleCount{}, culledCount{};
+    std::array<size_t, MaxLodLevels> lodCounts{};
+    BindCounts binds;
+};
+
+struct FrameData {
+    vk::raii::Fence drawFence;
+    vk::raii::Semaphore imgAcqSem;
+    UploadBuffer uploads;
+    // Sources of model uploads recorded into this frame, released once its fence signals
+    std::vector<vk::raii::su::BufferData> stagingBufs;
+    // One per thread that can record draws, the pools are reset wholesale once the fence signals
+    std::vector<RecordingSlot> drawSlots;
+    std::optional<RecordingSlot> uiSlot;
 };
 
 struct VulkanContext {
@@ -100,17 +267,42 @@ struct VulkanContext {
     std::optional<vk::raii::su::SwapChainData> swapChainData;
     std::optional<vk::raii::su::DepthBufferData> depthBufferData;
     std::vector<vk::raii::Framebuffer> framebufs;
+    // Signaled when rendering to a swap chain image is done, per image rather than per frame in flight
+    // since a present can still be waiting on it by the time the same frame in flight comes around again
+    std::vector<vk::raii::Semaphore> renderDoneSems;
     std::unordered_map<asset_handle_t, vk::raii::su::TextureData> textures;
+    std::optional<GeometryBuffer> vertexGeometry, indexGeometry;
     std::unordered_map<asset_handle_t, ModelBuffers> modelBufData;
+    // One when the device cannot multi draw indirect
+    uint32_t maxMultiDrawCount{1};
+    // Reused every frame to sort entities into buckets
+    std::vector<DrawInstance> drawInstances, drawSortScratch;
+    std::vector<DrawBucket> drawBuckets;
+    // Indexed by pipeline sort index
+    std::vector<PipelineBinding> drawBindings;
+    DynamicOffsets drawOffsets{};
+    CullingMode cullingMode{};
+    CullRegions cullRegions{};
+    // One per render world, each tracks its world's changes and is only touched by whoever owns that world at the time
+    std::array<SpatialIndex, 2> drawIndices;
+    std::array<SpatialIndexTracker, 2> drawTrackers;
+    CullSpheres cullSpheres;
+    std::vector<uint32_t> visibleInstances;
+    // Level each entity was last drawn at, indexed by entity so both render worlds share it
+    std::vector<uint8_t> lodLevels;
+    RenderStats renderStats;
     std::unordered_map<asset_handle_t, CubeMapData> cubeMaps;
-    aligned_vector<Material> materialUpload;
-    aligned_vector<ModelUpload> modelUpload;
     std::optional<vk::raii::RenderPass> renderPass;
+    vk::Format renderPassColorFormat{}, renderPassDepthFormat{};
     std::optional<vk::raii::DescriptorPool> descriptorPool;
     std::optional<vk::raii::PipelineCache> pipelineCache;
+    PipelineCacheStats pipelineCacheStats;
     std::unordered_map<asset_handle_t, Pipeline> modelPipelines;
-    std::optional<vk::raii::Semaphore> imgAcqSem;
-    std::optional<vk::raii::Fence> drawFence;
+    CullPipeline cullPipeline;
+    std::vector<FrameData> frames;
+    uint32_t framesInFlight{}, frameIdx{};
+    // Worker threads plus the render thread itself
+    uint32_t recordThreadCount{1};
 
     ImGui_ImplVulkanH_Window imGuiWindow;
     CameraUpload cameraUpload;
@@ -118,12 +310,30 @@ struct VulkanContext {
     uint32_t graphicsFamilyIdx, presentFamilyIdx;
 };
 
-void renderOpaque(App& app);
+void uploadModels(App& app, vk::raii::CommandBuffer const& cmdBuf);
 
-void renderImGui(App& app);
+/** @brief Gathers and uploads this frame's opaque instances, recorded before the render pass since it may dispatch culling */
+void prepareOpaque(App& app, vk::raii::CommandBuffer const& cmdBuf);
+
+/**
+ * @brief Records opaque draws into secondary command buffers, split across worker threads when there are enough of them.
+ * @param recorded  Appended with the command buffers to execute, in order
+ */
+void renderOpaque(App& app, vk::CommandBufferInheritanceInfo const& inheritance, std::vector<vk::CommandBuffer>& recorded);
+
+void buildImGui(App& app);
+
+void renderImGui(App& app, vk::CommandBufferInheritanceInfo const& inheritance, std::vector<vk::CommandBuffer>& recorded);
 
 void createSwapChain(VulkanContext& vk);
 
-void recreatePipeline(VulkanContext& vk);
+void recreateSwapChain(VulkanContext& vk);
 
 void createShaderPipeline(VulkanContext& vk, Pipeline& pipeline);
+
+void updateDynamicDescriptors(VulkanContext& vk, Pipeline& pipeline, uint32_t frameIdx);
+
+void createCullPipeline(VulkanContext& vk);
+
+/** @brief Records the frustum culling dispatch, followed by a barrier that makes its results visible to indirect draws */
+void dispatchCull(VulkanContext& vk, vk::raii::CommandBuffer const& cmdBuf, CullRegions const& regions);
@@ -1,160 +1,663 @@
 #include "render.hpp"
 
+#include <latch>
 #include <imgui.h>
 #include <backends/imgui_impl_glfw.h>
 #include <backends/imgui_impl_vulkan.h>
 
 #include "app.hpp"
 #include "inspector.hpp"
+#include "interleave.hpp"
 #include "shader_math.hpp"
+#include "collections/radix_sort.hpp"
 
 #define PositionAttr "POSITION"
+#define NormalAttr "NORMAL"
+#define TangentAttr "TANGENT"
 
-template<std::integral T>
-vk::raii::su::BufferData createIndexBufferData(VulkanContext const& vk, entt::resource<tinygltf::Model> const& model) {
-    tinygltf::Primitive& primitive = model->meshes.front().primitives.front();
-    tinygltf::Accessor& acc = model->accessors.at(primitive.indices);
-    GAME_ASSERT(acc.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT);
-    tinygltf::BufferView& view = model->bufferViews.at(acc.bufferView);
-    tinygltf::Buffer& buf = model->buffers.at(view.buffer);
-    vk::raii::su::BufferData bufData{*vk.physDev, *vk.device, view.byteLength, vk::BufferUsageFlagBits::eIndexBuffer};
-    auto dataStart = reinterpret_cast<std::byte*>(buf.data.data());
-    auto data = reinterpret_cast<T*>(dataStart + view.byteOffset + acc.byteOffset);
-//    auto devData = static_cast<T*>(vk.device->mapMemory(bufData.deviceMemory, 0, view.byteLength));
-    vk::raii::su::copyToDevice(*bufData.deviceMemory, data, acc.count);
-//    for (size_t i = 0; i < acc.count; ++i) {
-//        devData[i] = data[i];
-//    }
-//    vk.device->unmapMemory(bufData.deviceMemory);
-    return bufData;
-}
-
-void tryFillAttributeBuffer(
-        VulkanContext const& vk, entt::resource<tinygltf::Model> const& model, vk::raii::su::BufferData& bufData, std::string const& attrName,
-        uint32_t modelStride, vk::DeviceSize shaderStride, vk::DeviceSize offset
-) {
-    tinygltf::Primitive& primitive = model->meshes.front().primitives.front();
-    // Check if this model has a corresponding attribute by name
-    auto it = primitive.attributes.find(attrName);
-    if (it == primitive.attributes.end()) return;
-
-    uint32_t attrIdx = it->second;
-    tinygltf::Accessor& acc = model->accessors.at(attrIdx);
-    tinygltf::BufferView& view = model->bufferViews.at(acc.bufferView);
-    tinygltf::Buffer& buf = model->buffers.at(view.buffer);
-    auto modelData = reinterpret_cast<std::byte*>(buf.data.data()) + view.byteOffset + acc.byteOffset;
-    auto devData = static_cast<std::byte*>(bufData.deviceMemory->mapMemory(0, view.byteLength)) + offset;
-    for (uint32_t i = 0; i < acc.count; i++) {
-        std::memcpy(devData, modelData, modelStride);
-        modelData += modelStride;
-        devData += shaderStride;
-    }
-    bufData.deviceMemory->unmapMemory();
-}
-
-void renderOpaque(App& app) {
+std::byte const* accessorData(Model const& model, tinygltf::Accessor const& acc) {
+    tinygltf::BufferView const& view = model.bufferViews.at(acc.bufferView);
+    tinygltf::Buffer const& buf = model.buffers.at(view.buffer);
+    return reinterpret_cast<std::byte const*>(buf.data.data()) + view.byteOffset + acc.byteOffset;
+}
+
+size_t vertexCount(Model const& model, tinygltf::Primitive const& primitive) {
+    return model.accessors.at(primitive.attributes.at(PositionAttr)).count;
+}
+
+template<std::unsigned_integral T>
+void appendIndices(std::byte const* src, size_t count, uint32_t firstVertex, std::vector<uint32_t>& indices) {
+    for (size_t i = 0; i < count; ++i) {
+        T index;
+        std::memcpy(&index, src + i * sizeof(T), sizeof(T));
+        indices.push_back(firstVertex + index);
+    }
+}
+
+/** @brief Appends a primitive's indices widened to 32 bits, primitives without any draw their vertices in order */
+void appendIndices(Model const& model, ModelPrimitive const& primitive, uint32_t firstVertex, std::vector<uint32_t>& indices) {
+    size_t indexStart = indices.size();
+    int accessorIdx = primitive.primitive->indices;
+    if (accessorIdx < 0) {
+        size_t vertCount = vertexCount(model, *primitive.primitive);
+        for (size_t i = 0; i < vertCount; ++i) indices.push_back(firstVertex + static_cast<uint32_t>(i));
+    } else {
+        tinygltf::Accessor const& acc = model.accessors.at(accessorIdx);
+        std::byte const* src = accessorData(model, acc);
+        switch (acc.componentType) {
+            case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+                appendIndices<uint8_t>(src, acc.count, firstVertex, indices);
+                break;
+            case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+                appendIndices<uint16_t>(src, acc.count, firstVertex, indices);
+                break;
+            case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
+                appendIndices<uint32_t>(src, acc.count, firstVertex, indices);
+                break;
+            default:
+                throw std::runtime_error("Invalid index component type " + std::to_string(acc.componentType));
+        }
+    }
+    if ((indices.size() - indexStart) % 3 != 0) {
+        throw std::runtime_error("Triangle primitive index count is not a multiple of three");
+    }
+    if (!primitive.isMirrored) return;
+
+    for (size_t i = indexStart; i < indices.size(); i += 3) {
+        std::swap(indices[i + 1], indices[i + 2]);
+    }
+}
+
+void appendPositions(Model const& model, ModelPrimitive const& primitive, std::vector<vec3f>& positions) {
+    tinygltf::Accessor const& acc = model.accessors.at(primitive.primitive->attributes.at(PositionAttr));
+    if (acc.componentType != TINYGLTF_COMPONENT_TYPE_FLOAT || acc.type != TINYGLTF_TYPE_VEC3) {
+        throw std::runtime_error("Model positions are not made of three floats");
+    }
+    std::byte const* src = accessorData(model, acc);
+    auto byteStride = static_cast<size_t>(acc.ByteStride(model.bufferViews.at(acc.bufferView)));
+    for (size_t i = 0; i < acc.count; ++i) {
+        vec3f pos;
+        std::memcpy(&pos, src + i * byteStride, sizeof(vec3f));
+        vec4 transformed = primitive.transform * vec4{pos.x, pos.y, pos.z, 1.0};
+        positions.push_back({static_cast<float>(transformed.x), static_cast<float>(transformed.y), static_cast<float>(transformed.z)});
+    }
+}
+
+AttributeStream makeAttributeStream(Model const& model, tinygltf::Primitive const& primitive, VertexAttr const& attr, size_t vertCount) {
+    AttributeStream stream{
+            .src = nullptr,
+            .srcStride = 0,
+            .srcCompCount = attr.compCount,
+            .dstCompCount = attr.size / static_cast<uint32_t>(sizeof(float)),
+            .dstOffset = attr.offset
+    };
+    // Check if this primitive has a corresponding attribute by name, missing ones are left zeroed
+    auto it = primitive.attributes.find(attr.name);
+    if (it == primitive.attributes.end()) return stream;
+
+    tinygltf::Accessor const& acc = model.accessors.at(it->second);
+    if (acc.componentType != TINYGLTF_COMPONENT_TYPE_FLOAT) {
+        std::cerr << "[Vulkan] Attribute " << attr.name << " is not made of floats, skipping" << std::endl;
+        return stream;
+    }
+    if (acc.count < vertCount) {
+        throw std::runtime_error("Attribute " + attr.name + " has fewer elements than there are vertices");
+    }
+    int byteStride = acc.ByteStride(model.bufferViews.at(acc.bufferView));
+    if (byteStride <= 0) {
+        throw std::runtime_error("Invalid byte stride for attribute " + attr.name);
+    }
+    auto compCount = static_cast<uint32_t>(tinygltf::GetNumComponentsInType(static_cast<uint32_t>(acc.type)));
+    stream.src = accessorData(model, acc);
+    stream.srcStride = static_cast<size_t>(byteStride);
+    stream.srcCompCount = std::min(compCount, stream.dstCompCount);
+    return stream;
+}
+
+/** @brief Moves interleaved vertices from their node's space into model space, since all nodes of a model are drawn as one mesh */
+void bakeNodeTransform(ModelPrimitive const& primitive, Shader const& vertShader, std::byte* dst, size_t vertCount) {
+    for (auto& [location, attr]: vertShader.vertAttrs) {
+        bool isPosition = attr.name == PositionAttr, isNormal = attr.name == NormalAttr, isTangent = attr.name == TangentAttr;
+        size_t compCount = std::min<size_t>(attr.size / sizeof(float), 4);
+        if (!(isPosition || isNormal || isTangent) || compCount < 3) continue;
+
+        mat4 const& transform = isNormal ? primitive.normalTransform : primitive.transform;
+        for (size_t i = 0; i < vertCount; ++i) {
+            std::byte* vert = dst + i * vertShader.vertAttrStride + attr.offset;
+            std::array<float, 4> v{};
+            std::memcpy(v.data(), vert, compCount * sizeof(float));
+            vec4 transformed = transform * vec4{v[0], v[1], v[2], isPosition ? 1.0 : 0.0};
+            if (!isPosition) {
+                scalar length = std::sqrt(transformed.x * transformed.x + transformed.y * transformed.y + transformed.z * transformed.z);
+                if (length > 0.0) transformed = transformed * (1.0 / length);
+            }
+            v[0] = static_cast<float>(transformed.x);
+            v[1] = static_cast<float>(transformed.y);
+            v[2] = static_cast<float>(transformed.z);
+            // Mirroring flips which way the bitangent points
+            if (isTangent && primitive.isMirrored) v[3] = -v[3];
+            std::memcpy(vert, v.data(), compCount * sizeof(float));
+        }
+    }
+}
+
+void fillVertexBuffer(Model const& model, ModelPrimitive const& primitive, Shader const& vertShader, std::byte* dst) {
+    size_t vertCount = vertexCount(model, *primitive.primitive);
+    std::vector<AttributeStream> streams;
+    streams.reserve(vertShader.vertAttrs.size());
+    for (auto& [layout, attr]: vertShader.vertAttrs) {
+        streams.push_back(makeAttributeStream(model, *primitive.primitive, attr, vertCount));
+    }
+    interleaveVertices(streams, dst, vertShader.vertAttrStride, vertCount);
+    bakeNodeTransform(primitive, vertShader, dst, vertCount);
+}
+
+struct PendingModelUpload {
+    asset_handle_t handle;
+    Shader const* vertShader;
+    entt::resource<Model> model;
+    std::vector<ModelPrimitive> primitives;
+    Bounds bounds;
+    // Every detail level one after the other, relative to the model's first vertex
+    std::vector<uint32_t> indices;
+    std::vector<LodLevel> lods;
+    vk::DeviceSize vertSize, indexSize;
+};
+
+/** @brief Flattens every primitive of every node of the model into one mesh and builds its detail levels */
+PendingModelUpload prepareModelUpload(asset_handle_t handle, Shader const& vertShader, entt::resource<Model> model) {
+    std::vector<ModelPrimitive> primitives = collectPrimitives(*model);
+    Bounds bounds = calcModelBounds(*model);
+    std::vector<uint32_t> indices;
+    std::vector<vec3f> positions;
+    for (ModelPrimitive const& primitive: primitives) {
+        appendIndices(*model, primitive, static_cast<uint32_t>(positions.size()), indices);
+        appendPositions(*model, primitive, positions);
+    }
+    std::vector<LodLevel> lods;
+    std::vector<uint32_t> chain = buildLodChain(indices, positions, bounds, lods);
+    vk::DeviceSize vertSize = positions.size() * vertShader.vertAttrStride;
+    vk::DeviceSize indexSize = chain.size() * sizeof(uint32_t);
+    return {handle, &vertShader, std::move(model), std::move(primitives), bounds, std::move(chain), std::move(lods), vertSize, indexSize};
+}
+
+void uploadModels(App& app, vk::raii::CommandBuffer const& cmdBuf) {
     auto& vk = app.globalCtx.at<VulkanContext>();
-    vk.cmdBufs->front().setViewport(0, vk::Viewport(0.0f, 0.0f,
-                                                    static_cast<float>(vk.surfData->extent.width), static_cast<float>(vk.surfData->extent.height),
-                                                    0.0f, 1.0f));
-    vk.cmdBufs->front().setScissor(0, vk::Rect2D({}, vk.surfData->extent));
+    app.modelStreamer.collect(app.modelAssets);
+
+    // Models that are not resident yet are requested from the streamer and skipped when drawing until they are
+    std::vector<PendingModelUpload> pending;
+    vk::DeviceSize stagingSize = 0;
+    for (auto [ent, modelHandle, shaderHandle]: app.renderWorld().view<const ModelHandle, const ShaderHandle>().each()) {
+        if (vk.modelBufData.contains(modelHandle.value)) continue;
+
+        if (!app.modelAssets.contains(modelHandle.value)) {
+            app.modelStreamer.request(app.modelAssets, modelHandle.value, "models/Cube.glb");
+            continue;
+        }
+        // Spread uploads over multiple frames when many models finish loading at once
+        if (pending.size() == MaxModelUploadsPerFrame) continue;
+        bool isQueued = std::any_of(pending.begin(), pending.end(), [&](PendingModelUpload const& upload) { return upload.handle == modelHandle.value; });
+        if (isQueued) continue;
+
+        Shader const& vertShader = vk.modelPipelines.at(shaderHandle.value).shaders[0];
+        pending.push_back(prepareModelUpload(modelHandle.value, vertShader, app.modelAssets[modelHandle.value]));
+        stagingSize += pending.back().vertSize + pending.back().indexSize;
+    }
+    if (pending.empty()) return;
+
+    // Every model this frame shares one staging buffer, which lives until this frame's fence signals
+    FrameData& frame = vk.frames[vk.frameIdx];
+    vk::raii::su::BufferData& staging = frame.stagingBufs.emplace_back(*vk.physDev, *vk.device, stagingSize, vk::BufferUsageFlagBits::eTransferSrc);
+    auto stagingData = static_cast<std::byte*>(staging.deviceMemory->mapMemory(0, stagingSize));
+    vk::DeviceSize stagingOffset = 0;
+    for (PendingModelUpload& upload: pending) {
+        Model const& model = *upload.model;
+        uint32_t stride = upload.vertShader->vertAttrStride;
+        std::byte* vertDst = stagingData + stagingOffset;
+        for (ModelPrimitive const& primitive: upload.primitives) {
+            fillVertexBuffer(model, primitive, *upload.vertShader, vertDst);
+            vertDst += vertexCount(model, *primitive.primitive) * stride;
+        }
+        std::memcpy(stagingData + stagingOffset + upload.vertSize, upload.indices.data(), upload.indexSize);
+
+        // Vertices are aligned to their stride and indices to their size, so draws can address them by vertex offset and first index
+        GeometryAllocation vertices = vk.vertexGeometry->alloc(*vk.physDev, *vk.device, upload.vertSize, stride);
+        GeometryAllocation indices = vk.indexGeometry->alloc(*vk.physDev, *vk.device, upload.indexSize, sizeof(uint32_t));
+        cmdBuf.copyBuffer(**staging.buffer, vk.vertexGeometry->buffer(vertices.blockIdx), vk::BufferCopy(stagingOffset, vertices.offset, upload.vertSize));
+        cmdBuf.copyBuffer(**staging.buffer, vk.indexGeometry->buffer(indices.blockIdx),
+                          vk::BufferCopy(stagingOffset + upload.vertSize, indices.offset, upload.indexSize));
+        stagingOffset += upload.vertSize + upload.indexSize;
+
+        auto firstIndex = static_cast<uint32_t>(indices.offset / sizeof(uint32_t));
+        for (LodLevel& lod: upload.lods) lod.firstIndex += firstIndex;
+        auto [_, wasBufAdded] = vk.modelBufData.emplace(upload.handle, ModelBuffers{
+                vertices,
+                indices,
+                static_cast<int32_t>(vertices.offset / stride),
+                std::move(upload.lods),
+                upload.bounds,
+                static_cast<uint32_t>(vk.modelBufData.size())
+        });
+        GAME_ASSERT(wasBufAdded);
+    }
+    staging.deviceMemory->unmapMemory();
+
+    // Copies have to land before this frame's render pass fetches vertices and indices
+    cmdBuf.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eVertexInput, {},
+                           vk::MemoryBarrier(vk::AccessFlagBits::eTransferWrite,
+                                             vk::AccessFlagBits::eVertexAttributeRead | vk::AccessFlagBits::eIndexRead),
+                           nullptr, nullptr);
+}
+
+/**
+ * @brief Where to draw an entity, between where it was before the latest tick and where it is now.
+ *        Model matrices are translation only, so the previous orientation is not blended yet.
+ */
+Position interpolatePosition(World const& world, entt::entity ent, Position const& pos, double alpha) {
+    auto* prev = world.try_get<PreviousTransform>(ent);
+    if (!prev) return pos;
+
+    return Position{edyn::lerp(prev->position, pos, alpha)};
+}
+
+struct RecordingProgress {
+    std::atomic<size_t> next{0};
+    std::latch done;
+    std::vector<std::exception_ptr> errors;
+    std::vector<BindCounts> binds;
+
+    explicit RecordingProgress(size_t rangeCount) : done(static_cast<std::ptrdiff_t>(rangeCount)), errors(rangeCount), binds(rangeCount) {}
+};
+
+// Below this many instances per thread recording in parallel costs more than it saves
+constexpr size_t MinInstancesPerRecording = 256;
+
+// Pipeline in the top bits, then mesh, then depth in the bottom ones, so whatever is most expensive to switch changes least often
+constexpr uint32_t DrawKeyPipelineBits = 16, DrawKeyMeshBits = 24, DrawKeyDepthBits = 24;
+
+/** @param depth    Distance from the camera as a fraction of the far plane distance, anything beyond sorts as equally far */
+DrawKey makeDrawKey(uint32_t pipelineIdx, uint32_t meshIdx, double depth) {
+    GAME_ASSERT(pipelineIdx < (1u << DrawKeyPipelineBits) && meshIdx < (1u << DrawKeyMeshBits));
+    constexpr uint64_t maxDepth = (uint64_t{1} << DrawKeyDepthBits) - 1;
+    auto quantizedDepth = static_cast<uint64_t>(std::clamp(depth, 0.0, 1.0) * static_cast<double>(maxDepth));
+    return uint64_t{pipelineIdx} << (DrawKeyMeshBits + DrawKeyDepthBits) | uint64_t{meshIdx} << DrawKeyDepthBits | quantizedDepth;
+}
+
+void setViewportAndScissor(VulkanContext const& vk, vk::raii::CommandBuffer const& cmdBuf) {
+    cmdBuf.setViewport(0, vk::Viewport(0.0f, 0.0f,
+                                       static_cast<float>(vk.surfData->extent.width), static_cast<float>(vk.surfData->extent.height),
+                                       0.0f, 1.0f));
+    cmdBuf.setScissor(0, vk::Rect2D({}, vk.surfData->extent));
+}
+
+/** @brief Remembers what a command buffer has bound, so each bucket only binds what differs from the bucket before it */
+class DrawBinder {
+public:
+    DrawBinder(VulkanContext const& vk, vk::raii::CommandBuffer const& cmdBuf) : mVk(vk), mCmdBuf(cmdBuf) {}
+
+    /** @param drawCount   Draws the following call issues with these bindings */
+    void bind(DrawBucket const& bucket, size_t drawCount = 1) {
+        if (bucket.bindingIdx != mBindingIdx) {
+            PipelineBinding const& binding = mVk.drawBindings[bucket.bindingIdx];
+            Pipeline const& pipeline = *binding.pipeline;
+            mCmdBuf.bindPipeline(vk::PipelineBindPoint::eGraphics, **pipeline.value);
+            mCmdBuf.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, **pipeline.layout, 0u, binding.descSets, binding.dynamicOffsets);
+            mBindingIdx = bucket.bindingIdx;
+            mCounts.pipelineBinds++;
+        }
+        // Vertex and index buffers stay bound when the pipeline changes, and most models share the same blocks
+        ModelBuffers const& buffers = *bucket.buffers;
+        bool isVertexBlockBound = buffers.vertices.blockIdx == mVertexBlockIdx, isIndexBlockBound = buffers.indices.blockIdx == mIndexBlockIdx;
+        if (!isVertexBlockBound) {
+            mCmdBuf.bindVertexBuffers(0, mVk.vertexGeometry->buffer(buffers.vertices.blockIdx), {0});
+            mVertexBlockIdx = buffers.vertices.blockIdx;
+        }
+        if (!isIndexBlockBound) {
+            mCmdBuf.bindIndexBuffer(mVk.indexGeometry->buffer(buffers.indices.blockIdx), 0, vk::IndexType::eUint32);
+            mIndexBlockIdx = buffers.indices.blockIdx;
+        }
+        if (!isVertexBlockBound || !isIndexBlockBound) mCounts.geometryBinds++;
+        mCounts.draws += drawCount;
+        mCounts.calls++;
+    }
+
+    /** @brief Whether nothing has to be bound between drawing two buckets */
+    static bool sharesBindings(DrawBucket const& a, DrawBucket const& b) {
+        return a.bindingIdx == b.bindingIdx &&
+               a.buffers->vertices.blockIdx == b.buffers->vertices.blockIdx && a.buffers->indices.blockIdx == b.buffers->indices.blockIdx;
+    }
+
+    [[nodiscard]] BindCounts const& counts() const {
+        return mCounts;
+    }
+
+private:
+    VulkanContext const& mVk;
+    vk::raii::CommandBuffer const& mCmdBuf;
+    uint32_t mBindingIdx = std::numeric_limits<uint32_t>::max();
+    uint32_t mVertexBlockIdx = std::numeric_limits<uint32_t>::max(), mIndexBlockIdx = std::numeric_limits<uint32_t>::max();
+    BindCounts mCounts;
+};
+
+/** @brief Records the draws for a range of the sorted draw instances, buckets crossing the range ends are cut there */
+BindCounts recordDraws(VulkanContext const& vk, vk::raii::CommandBuffer const& cmdBuf, vk::CommandBufferInheritanceInfo const& inheritance,
+                       size_t instanceBegin, size_t instanceEnd) {
+    // Secondaries inherit nothing but the render pass, dynamic state and bindings have to be set again in each
+    cmdBuf.begin({vk::CommandBufferUsageFlagBits::eOneTimeSubmit | vk::CommandBufferUsageFlagBits::eRenderPassContinue, &inheritance});
+    setViewportAndScissor(vk, cmdBuf);
 
+    DrawBinder binder(vk, cmdBuf);
+    for (DrawBucket const& bucket: vk.drawBuckets) {
+        if (bucket.first >= instanceEnd) break;
+
+        size_t bucketBegin = std::max<size_t>(bucket.first, instanceBegin);
+        size_t bucketEnd = std::min<size_t>(bucket.first + bucket.count, instanceEnd);
+        if (bucketBegin >= bucketEnd) continue;
+
+        binder.bind(bucket);
+        LodLevel const& lod = bucket.buffers->lods[bucket.lod];
+        cmdBuf.drawIndexed(lod.indexCount, static_cast<uint32_t>(bucketEnd - bucketBegin), lod.firstIndex, bucket.buffers->vertexOffset,
+                           static_cast<uint32_t>(bucketBegin));
+    }
+    cmdBuf.end();
+    return binder.counts();
+}
+
+/** @brief Records one indirect draw per bucket, instance counts are filled in on the GPU by the cull dispatch */
+BindCounts recordIndirectDraws(VulkanContext const& vk, vk::raii::CommandBuffer const& cmdBuf, vk::CommandBufferInheritanceInfo const& inheritance) {
+    cmdBuf.begin({vk::CommandBufferUsageFlagBits::eOneTimeSubmit | vk::CommandBufferUsageFlagBits::eRenderPassContinue, &inheritance});
+    setViewportAndScissor(vk, cmdBuf);
+
+    // Commands are laid out in bucket order, so runs of buckets that share their bindings go out as one multi draw
+    vk::Buffer commandBuf = vk.frames[vk.frameIdx].uploads.buffer();
+    std::vector<DrawBucket> const& buckets = vk.drawBuckets;
+    DrawBinder binder(vk, cmdBuf);
+    for (size_t runStart = 0; runStart < buckets.size();) {
+        size_t runEnd = runStart + 1;
+        while (runEnd < buckets.size() && runEnd - runStart < vk.maxMultiDrawCount && DrawBinder::sharesBindings(buckets[runStart], buckets[runEnd])) {
+            runEnd++;
+        }
+        auto drawCount = static_cast<uint32_t>(runEnd - runStart);
+        binder.bind(buckets[runStart], drawCount);
+        cmdBuf.drawIndexedIndirect(commandBuf, vk.cullRegions.bucketCommands + runStart * sizeof(vk::DrawIndexedIndirectCommand),
+                                   drawCount, sizeof(vk::DrawIndexedIndirectCommand));
+        runStart = runEnd;
+    }
+    cmdBuf.end();
+    return binder.counts();
+}
+
+/** @brief Points every pipeline's descriptors at this frame's uploads, recording threads only read the result */
+void bindPipelines(VulkanContext& vk) {
+    UploadBuffer const& uploads = vk.frames[vk.frameIdx].uploads;
+    vk.drawBindings.resize(vk.modelPipelines.size());
     for (auto& [handle, pipeline]: vk.modelPipelines) {
-        Shader const& vertShader = pipeline.shaders[0];
-        vk.cmdBufs->front().bindPipeline(vk::PipelineBindPoint::eGraphics, **pipeline.value);
-        auto renderCtx = app.renderWorld.ctx().at<RenderContext>();
-        auto playerIt = app.renderWorld.view<const Position, const Look, const Player>().each();
-        for (auto [ent, pos, look, player]: playerIt) {
-            if (player.possessionId != renderCtx.possessionId) continue;
-
-            CameraUpload camera{
-                    .view = toShader(calcView(pos, look)),
-                    .proj = toShader(calcProj(vk.surfData->extent)),
-                    .clip = toShader(ClipMat),
-                    .camPos = toShader(pos)
-            };
-            vk::raii::su::copyToDevice(*pipeline.uniforms.find({0, 0})->second.deviceMemory, camera);
-        }
-
-        SceneUpload scene{
-                .lightDir = {1.0f, 1.0f, -1.0f, 0.0f},
-                .exposure = 4.5f,
-                .gamma = 2.2f,
-                .prefilteredCubeMipLevels = 0.0f,
-                .scaleIBLAmbient = 1.0f,
-                .debugViewInputs = 0,
-                .debugViewEquation = 0
+        PipelineFrame& pipelineFrame = pipeline.frames[vk.frameIdx];
+        if (pipelineFrame.uploadGeneration != uploads.generation()) {
+            updateDynamicDescriptors(vk, pipeline, vk.frameIdx);
+        }
+        PipelineBinding& binding = vk.drawBindings.at(pipeline.sortIdx);
+        binding.pipeline = &pipeline;
+        binding.descSets.clear();
+        for (auto& descSet: pipelineFrame.descSets) binding.descSets.push_back(*descSet);
+
+        // Per instance data is indexed in the shader, so one bind covers every draw
+        binding.dynamicOffsets.resize(pipeline.dynamicBindings.size());
+        for (size_t i = 0; i < binding.dynamicOffsets.size(); ++i) {
+            binding.dynamicOffsets[i] = vk.drawOffsets[static_cast<size_t>(pipeline.dynamicBindings[i].uniform)];
+        }
+    }
+}
+
+void prepareOpaque(App& app, vk::raii::CommandBuffer const& cmdBuf) {
+    auto& vk = app.globalCtx.at<VulkanContext>();
+    bool isGpuCulled = vk.cullingMode == CullingMode::Gpu;
+    vk.drawBuckets.clear();
+    vk.renderStats.binds = {};
+    vk.renderStats.lodCounts = {};
+
+    CameraUpload camera{};
+    std::optional<Frustum> frustum;
+    vec3 camPos{};
+    double focalLength = 1.0;
+    World const& renderWorld = app.renderWorld();
+    auto renderCtx = renderWorld.ctx().at<RenderContext>();
+    for (auto [ent, tickPos, look, player]: renderWorld.view<const Position, const Look, const Player>().each()) {
+        if (player.possessionId != renderCtx.possessionId) continue;
+
+        Position pos = interpolatePosition(renderWorld, ent, tickPos, renderCtx.alpha);
+        mat4 view = calcView(pos, look), proj = calcProj(vk.surfData->extent);
+        camera = {
+                .view = toShader(view),
+                .proj = toShader(proj),
+                .clip = toShader(ClipMat),
+                .camPos = toShader(pos)
         };
+        frustum = extractFrustum(ClipMat * proj * view);
+        camPos = pos;
+        focalLength = proj[1][1];
+    }
+
+    // Only the front render world's index is touched here, the other one's tracker is picking up this frame's extract
+    SpatialIndex& drawIndex = vk.drawIndices[app.renderWorldIdx];
+    vk.drawTrackers[app.renderWorldIdx].update(renderWorld, drawIndex, [&](asset_handle_t handle) -> Bounds const* {
+        auto it = vk.modelBufData.find(handle);
+        return it == vk.modelBufData.end() ? nullptr : &it->second.bounds;
+    });
 
-        vk::raii::su::copyToDevice(*pipeline.uniforms.find({0, 1})->second.deviceMemory, scene);
-
-        uint32_t drawIdx;
-        auto modelView = app.renderWorld.view<const Position, const Orientation, const Material, const ModelHandle>();
-        // We store data per model in a dynamic UBO to save memory
-        // This way we only have one upload
-        drawIdx = 0;
-        for (auto [ent, pos, orien, material, modelHandle]: modelView.each()) {
-            vk.modelUpload[drawIdx] = {toShader(calcModel(pos))};
-            vk.materialUpload[drawIdx] = material;
-            drawIdx++;
-        }
-
-        void* mappedModelData = pipeline.uniforms.find({2, 0})->second.deviceMemory->mapMemory(0, vk.modelUpload.mem_size());
-        memcpy(mappedModelData, vk.modelUpload.data(), vk.modelUpload.mem_size());
-        pipeline.uniforms.find({2, 0})->second.deviceMemory->unmapMemory();
-
-        void* mappedMaterialData = pipeline.uniforms.find({2, 1})->second.deviceMemory->mapMemory(0, vk.materialUpload.mem_size());
-        memcpy(mappedMaterialData, vk.materialUpload.data(), vk.materialUpload.mem_size());
-        pipeline.uniforms.find({2, 1})->second.deviceMemory->unmapMemory();
-
-        // TODO: is this same order?
-        drawIdx = 0;
-        for (auto [ent, pos, orien, _, modelHandle]: modelView.each()) {
-            entt::resource<Model> model;
-            ModelBuffers* rawModelBuffers;
-            auto modelBufIt = vk.modelBufData.find(modelHandle.value);
-            // Check if we need to create a vertex buffer for this model
-            if (modelBufIt == vk.modelBufData.end()) {
-                auto [assetIt, wasAssetAdded] = app.modelAssets.load(modelHandle.value, "models/Cube.glb");
-                GAME_ASSERT(wasAssetAdded);
-                model = assetIt->second;
-                GAME_ASSERT(model);
-
-                auto vertCount = static_cast<uint32_t>(model->accessors[model->meshes.front().primitives.front().attributes.at(PositionAttr)].count);
-                vk::raii::su::BufferData vertBufData{*vk.physDev, *vk.device, vertCount * vertShader.vertAttrStride,
-                                                     vk::BufferUsageFlagBits::eVertexBuffer};
-                for (auto& [layout, attr]: vertShader.vertAttrs) {
-                    tryFillAttributeBuffer(vk, model, vertBufData, attr.name, attr.size, vertShader.vertAttrStride, attr.offset);
-                }
-                auto [addedIt, wasBufAdded] = vk.modelBufData.emplace(modelHandle.value, ModelBuffers{
-                        createIndexBufferData<uint16_t>(vk, model),
-                        std::move(vertBufData)
-                });
-                GAME_ASSERT(wasBufAdded);
-                rawModelBuffers = &addedIt->second;
-            } else {
-                model = app.modelAssets[modelHandle.value];
-                rawModelBuffers = &modelBufIt->second;
+    auto modelView = app.renderWorld().view<const Position, const Orientation, const Material, const ModelHandle, const ShaderHandle>();
+    std::vector<DrawInstance>& drawInstances = vk.drawInstances;
+    CullSpheres& spheres = vk.cullSpheres;
+    drawInstances.clear();
+    spheres.clear();
+    auto addDrawInstance = [&](entt::entity ent) {
+        if (!modelView.contains(ent)) return;
+
+        auto [tickPos, modelHandle, shaderHandle] = modelView.get<const Position, const ModelHandle, const ShaderHandle>(ent);
+        auto modelBufIt = vk.modelBufData.find(modelHandle.value);
+        if (modelBufIt == vk.modelBufData.end()) return;
+        auto pipelineIt = vk.modelPipelines.find(shaderHandle.value);
+        if (pipelineIt == vk.modelPipelines.end()) return;
+
+        // Keys are made once culling has thinned things out
+        ModelBuffers const& buffers = modelBufIt->second;
+        Position pos = interpolatePosition(renderWorld, ent, tickPos, renderCtx.alpha);
+        drawInstances.push_back({0, pipelineIt->second.sortIdx, &buffers, 0, ent, pos});
+        if (isGpuCulled) return;
+
+        // Model matrices are translation only, so the model space sphere just moves along
+        spheres.push(pos + buffers.bounds.center, buffers.bounds.radius);
+    };
+    // Without a camera there is nothing to cull against, which only happens before a player is possessed
+    if (frustum) {
+        // The tree rejects whole regions at once, its leaves are fattened though so survivors are tested again one by one
+        drawIndex.query([&](BoundingBox const& box) { return isBoxVisible(*frustum, box); }, addDrawInstance);
+        if (!isGpuCulled) {
+            cullSpheres(*frustum, spheres, vk.visibleInstances);
+            // Visible indices are ascending, so compacting in place never overwrites one that is still to be read
+            for (size_t i = 0; i < vk.visibleInstances.size(); ++i) {
+                drawInstances[i] = drawInstances[vk.visibleInstances[i]];
             }
-            if (rawModelBuffers) {
-                vk.cmdBufs->front().bindVertexBuffers(0, **rawModelBuffers->vertBufData.buffer, {0});
-                vk.cmdBufs->front().bindIndexBuffer(**rawModelBuffers->indexBufData.buffer, 0, vk::IndexType::eUint16);
-                std::array<uint32_t, 2> dynamicOffsets{
-                        static_cast<uint32_t>(drawIdx * vk.modelUpload.block_size()),
-                        static_cast<uint32_t>(drawIdx * vk.materialUpload.block_size())
-                };
-
-                std::vector<vk::DescriptorSet> proxyDescSets;
-                proxyDescSets.reserve(pipeline.descSets.size());
-                for (auto& descSet: pipeline.descSets) proxyDescSets.push_back(*descSet);
-
-                vk.cmdBufs->front().bindDescriptorSets(vk::PipelineBindPoint::eGraphics, **pipeline.layout, 0u, proxyDescSets, dynamicOffsets);
-                auto indexCount = static_cast<uint32_t>(model->accessors[model->meshes.front().primitives.front().indices].count);
-                vk.cmdBufs->front().drawIndexed(indexCount, 1, 0, 0, 0);
+            drawInstances.resize(vk.visibleInstances.size());
+        }
+        vk.renderStats.culledCount = drawIndex.size() - drawInstances.size();
+    } else {
+        for (entt::entity ent: modelView) addDrawInstance(ent);
+        vk.renderStats.culledCount = 0;
+    }
+    vk.renderStats.visibleCount = drawInstances.size();
+    if (drawInstances.empty()) return;
+
+    // Front to back lets early depth testing skip shading hidden fragments, but only when draws keep their order.
+    // GPU culling writes instances in whatever order its threads get there, so depth is left out and those sort passes are skipped.
+    for (DrawInstance& instance: drawInstances) {
+        Bounds const& bounds = instance.buffers->bounds;
+        scalar distance = edyn::length(instance.pos + bounds.center - camPos);
+        // Distant models cover few pixels, so they are drawn with a fraction of their triangles
+        if (frustum) {
+            auto entIdx = static_cast<size_t>(entt::to_entity(instance.ent));
+            if (entIdx >= vk.lodLevels.size()) vk.lodLevels.resize(entIdx + 1);
+            instance.lod = selectLod(vk.lodLevels[entIdx], static_cast<uint32_t>(instance.buffers->lods.size()),
+                                     calcScreenSize(bounds.radius, distance, focalLength));
+            vk.lodLevels[entIdx] = static_cast<uint8_t>(instance.lod);
+        }
+        vk.renderStats.lodCounts[instance.lod]++;
+
+        double depth = isGpuCulled ? 0.0 : distance / ZFar;
+        instance.key = makeDrawKey(instance.bindingIdx, instance.buffers->sortIdx * MaxLodLevels + instance.lod, depth);
+    }
+    radix_sort(drawInstances, vk.drawSortScratch, [](DrawInstance const& instance) { return instance.key; });
+    size_t instanceCount = drawInstances.size();
+    for (size_t bucketStart = 0; bucketStart < instanceCount;) {
+        DrawKey bucketKey = drawInstances[bucketStart].key >> DrawKeyDepthBits;
+        size_t bucketEnd = bucketStart;
+        while (bucketEnd < instanceCount && drawInstances[bucketEnd].key >> DrawKeyDepthBits == bucketKey) bucketEnd++;
+
+        DrawInstance const& first = drawInstances[bucketStart];
+        vk.drawBuckets.push_back({first.bindingIdx, first.buffers, first.lod, static_cast<uint32_t>(bucketStart), static_cast<uint32_t>(bucketEnd - bucketStart)});
+        bucketStart = bucketEnd;
+    }
+    size_t bucketCount = vk.drawBuckets.size();
+
+    // All uniforms for this frame are written straight into persistently mapped memory
+    // Pipelines only differ in how they bind them, so everything is uploaded once up front
+    UploadBuffer& uploads = vk.frames[vk.frameIdx].uploads;
+    DynamicOffsets& offsets = vk.drawOffsets;
+
+    // Grow before allocating anything, pipelines notice the new buffer by its generation and rewrite their descriptors
+    vk::DeviceSize uploadSize = uploads.alignUp(sizeof(CameraUpload)) + uploads.alignUp(sizeof(SceneUpload)) +
+                                uploads.alignUp(sizeof(ModelUpload) * instanceCount) + uploads.alignUp(sizeof(MaterialUpload) * instanceCount) +
+                                uploads.alignUp(sizeof(uint32_t) * instanceCount);
+    if (isGpuCulled) {
+        uploadSize += uploads.alignUp(sizeof(CullUpload)) + uploads.alignUp(sizeof(vec4f) * instanceCount) +
+                      uploads.alignUp(sizeof(uint32_t) * instanceCount) + uploads.alignUp(sizeof(vk::DrawIndexedIndirectCommand) * bucketCount);
+    }
+    uploads.reserve(*vk.physDev, *vk.device, uploadSize);
+
+    offsets[static_cast<size_t>(DynamicUniform::Camera)] = uploads.push(camera);
+
+    SceneUpload scene{
+            .lightDir = {1.0f, 1.0f, -1.0f, 0.0f},
+            .exposure = 4.5f,
+            .gamma = 2.2f,
+            .prefilteredCubeMipLevels = 0.0f,
+            .scaleIBLAmbient = 1.0f,
+            .debugViewInputs = 0,
+            .debugViewEquation = 0
+    };
+    offsets[static_cast<size_t>(DynamicUniform::Scene)] = uploads.push(scene);
+
+    // Instance data is laid out in bucket order, shaders find it through the instance indices
+    UploadAllocation instanceAlloc = uploads.alloc(sizeof(ModelUpload) * instanceCount);
+    UploadAllocation materialAlloc = uploads.alloc(sizeof(MaterialUpload) * instanceCount);
+    UploadAllocation indexAlloc = uploads.alloc(sizeof(uint32_t) * instanceCount);
+    offsets[static_cast<size_t>(DynamicUniform::Instances)] = instanceAlloc.offset;
+    offsets[static_cast<size_t>(DynamicUniform::Materials)] = materialAlloc.offset;
+    offsets[static_cast<size_t>(DynamicUniform::InstanceIndices)] = indexAlloc.offset;
+    bindPipelines(vk);
+    std::optional<UploadAllocation> sphereAlloc, instanceBucketAlloc;
+    if (isGpuCulled) {
+        sphereAlloc = uploads.alloc(sizeof(vec4f) * instanceCount);
+        instanceBucketAlloc = uploads.alloc(sizeof(uint32_t) * instanceCount);
+    }
+    for (size_t bucketIdx = 0; bucketIdx < bucketCount; ++bucketIdx) {
+        DrawBucket const& bucket = vk.drawBuckets[bucketIdx];
+        Bounds const& bounds = bucket.buffers->bounds;
+        for (size_t instanceIdx = bucket.first; instanceIdx < bucket.first + bucket.count; ++instanceIdx) {
+            DrawInstance const& instance = drawInstances[instanceIdx];
+            ModelUpload model{toShader(calcModel(instance.pos))};
+            MaterialUpload materialUpload{modelView.get<const Material>(instance.ent)};
+            std::memcpy(instanceAlloc.data + instanceIdx * sizeof(ModelUpload), &model, sizeof(model));
+            std::memcpy(materialAlloc.data + instanceIdx * sizeof(MaterialUpload), &materialUpload, sizeof(materialUpload));
+            if (!isGpuCulled) {
+                // Everything drawn is already known to be visible, so draws map straight onto instance data
+                auto index = static_cast<uint32_t>(instanceIdx);
+                std::memcpy(indexAlloc.data + instanceIdx * sizeof(uint32_t), &index, sizeof(index));
+                continue;
             }
-            drawIdx++;
+
+            vec3 center = instance.pos + bounds.center;
+            vec4f sphere{static_cast<float>(center.x), static_cast<float>(center.y), static_cast<float>(center.z), static_cast<float>(bounds.radius)};
+            auto bucketIdx32 = static_cast<uint32_t>(bucketIdx);
+            std::memcpy(sphereAlloc->data + instanceIdx * sizeof(vec4f), &sphere, sizeof(sphere));
+            std::memcpy(instanceBucketAlloc->data + instanceIdx * sizeof(uint32_t), &bucketIdx32, sizeof(bucketIdx32));
         }
     }
+    if (!isGpuCulled) return;
+
+    // Instance counts start at zero and are counted up by the dispatch, each bucket has room for all of its instances
+    UploadAllocation commandAlloc = uploads.alloc(sizeof(vk::DrawIndexedIndirectCommand) * bucketCount);
+    for (size_t bucketIdx = 0; bucketIdx < bucketCount; ++bucketIdx) {
+        DrawBucket const& bucket = vk.drawBuckets[bucketIdx];
+        LodLevel const& lod = bucket.buffers->lods[bucket.lod];
+        vk::DrawIndexedIndirectCommand command{lod.indexCount, 0, lod.firstIndex, bucket.buffers->vertexOffset, bucket.first};
+        std::memcpy(commandAlloc.data + bucketIdx * sizeof(command), &command, sizeof(command));
+    }
+    CullUpload cull{
+            .planes = frustum ? frustum->planes : std::array<vec4f, 6>{},
+            .instanceCount = static_cast<uint32_t>(instanceCount),
+            .bucketCount = static_cast<uint32_t>(bucketCount),
+    };
+    vk.cullRegions = {
+            .cull = uploads.push(cull),
+            .spheres = sphereAlloc->offset,
+            .instanceBuckets = instanceBucketAlloc->offset,
+            .bucketCommands = commandAlloc.offset,
+            .instanceIndices = indexAlloc.offset,
+            .instanceCount = static_cast<uint32_t>(instanceCount),
+            .bucketCount = static_cast<uint32_t>(bucketCount),
+    };
+    dispatchCull(vk, cmdBuf, vk.cullRegions);
+}
+
+void renderOpaque(App& app, vk::CommandBufferInheritanceInfo const& inheritance, std::vector<vk::CommandBuffer>& recorded) {
+    auto& vk = app.globalCtx.at<VulkanContext>();
+    if (vk.drawBuckets.empty()) return;
+
+    std::vector<RecordingSlot>& slots = vk.frames[vk.frameIdx].drawSlots;
+    if (vk.cullingMode == CullingMode::Gpu) {
+        // Only a handful of draws per pipeline, not worth spreading over threads
+        vk.renderStats.binds = recordIndirectDraws(vk, slots.front().cmdBuf, inheritance);
+        recorded.push_back(*slots.front().cmdBuf);
+        return;
+    }
+
+    // Small frames are not worth the hand off, so only split once every thread gets a decent share of instances
+    size_t instanceCount = vk.drawInstances.size();
+    size_t rangeCount = std::clamp<size_t>(instanceCount / MinInstancesPerRecording, 1, slots.size());
+    size_t rangeSize = (instanceCount + rangeCount - 1) / rangeCount;
+
+    // Helpers may only get to run after every range has been claimed and this function has returned,
+    // so everything they touch before claiming one is shared. Anything else is only used while we wait on the latch.
+    auto progress = std::make_shared<RecordingProgress>(rangeCount);
+    auto recordRanges = [progress, rangeCount, rangeSize, instanceCount, &vk, &slots, &inheritance] {
+        while (true) {
+            size_t rangeIdx = progress->next.fetch_add(1);
+            if (rangeIdx >= rangeCount) break;
+
+            try {
+                size_t begin = rangeIdx * rangeSize;
+                progress->binds[rangeIdx] = recordDraws(vk, slots[rangeIdx].cmdBuf, inheritance, begin, std::min(begin + rangeSize, instanceCount));
+            } catch (...) {
+                progress->errors[rangeIdx] = std::current_exception();
+            }
+            progress->done.count_down();
+        }
+    };
+    for (size_t i = 1; i < rangeCount; ++i) {
+        app.threadPool.post(recordRanges);
+    }
+    // Record alongside the workers, this also means we never wait on a pool that is busy with something else
+    recordRanges();
+    progress->done.wait();
+
+    for (size_t i = 0; i < rangeCount; ++i) {
+        if (progress->errors[i]) std::rethrow_exception(progress->errors[i]);
+        recorded.push_back(*slots[i].cmdBuf);
+        // Every range starts out with nothing bound, so splitting costs a few binds of its own
+        vk.renderStats.binds += progress->binds[i];
+    }
 }
 
 void renderImGuiOverlay(App& app) {
@@ -180,6 +683,28 @@ void renderImGuiOverlay(App& app) {
     if (ImGui::Begin("Diagnostics", &open, windowFlags)) {
         clock_delta_t avgFrameTime = diagnostics.getAvgFrameTime();
         ImGui::Text("%.3f ms/frame (%.1f FPS)", ms_t(avgFrameTime).count(), 1.0 / sec_t(avgFrameTime).count());
+        auto& vk = app.globalCtx.at<VulkanContext>();
+        RenderStats const& renderStats = vk.renderStats;
+        bool isGpuCulled = vk.cullingMode == CullingMode::Gpu;
+        ImGui::Text("%s: %zu, culled: %zu", isGpuCulled ? "Sent to GPU culling" : "Drawn", renderStats.visibleCount, renderStats.culledCount);
+        std::array<size_t, MaxLodLevels> const& lodCounts = renderStats.lodCounts;
+        ImGui::Text("Per detail level: %zu, %zu, %zu, %zu", lodCounts[0], lodCounts[1], lodCounts[2], lodCounts[3]);
+        BindCounts const& binds = renderStats.binds;
+        ImGui::Text("Draws: %zu in %zu calls, binds skipped: %zu pipeline, %zu geometry",
+                    binds.draws, binds.calls, binds.draws - binds.pipelineBinds, binds.draws - binds.geometryBinds);
+        ImGui::Text("Geometry: %.1f MiB in %zu vertex and %zu index blocks",
+                    static_cast<double>(vk.vertexGeometry->size() + vk.indexGeometry->size()) / (1 << 20),
+                    vk.vertexGeometry->blockCount(), vk.indexGeometry->blockCount());
+        PipelineCacheStats const& cacheStats = vk.pipelineCacheStats;
+        if (uint32_t total = cacheStats.hits + cacheStats.misses; cacheStats.isSupported && total) {
+            ImGui::Text("Pipeline cache: %u/%u hits (%.0f%%)", cacheStats.hits, total, 100.0 * cacheStats.hits / total);
+        }
+        if (ImGui::TreeNode("Systems")) {
+            for (SystemTiming const& timing: app.scheduler.timings()) {
+                ImGui::Text("%s: %.3f ms", timing.name.c_str(), ms_t(timing.average).count());
+            }
+            ImGui::TreePop();
+        }
         if (ImGui::BeginPopupContextWindow()) {
             if (ImGui::MenuItem("Custom", nullptr, corner == -1)) corner = -1;
             if (ImGui::MenuItem("Top-left", nullptr, corner == 0)) corner = 0;
@@ -193,8 +718,7 @@ void renderImGuiOverlay(App& app) {
     ImGui::End();
 }
 
-void renderImGui(App& app) {
-    auto& vk = app.globalCtx.at<VulkanContext>();
+void buildImGui(App& app) {
     ImGui_ImplVulkan_NewFrame();
     ImGui_ImplGlfw_NewFrame();
     ImGui::NewFrame();
@@ -204,5 +728,13 @@ void renderImGui(App& app) {
     renderImGuiInspector(app);
     renderImGuiOverlay(app);
     ImGui::Render();
-    ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), static_cast<VkCommandBuffer>(*vk.cmdBufs->front()));
+}
+
+void renderImGui(App& app, vk::CommandBufferInheritanceInfo const& inheritance, std::vector<vk::CommandBuffer>& recorded) {
+    auto& vk = app.globalCtx.at<VulkanContext>();
+    vk::raii::CommandBuffer const& cmdBuf = vk.frames[vk.frameIdx].uiSlot->cmdBuf;
+    cmdBuf.begin({vk::CommandBufferUsageFlagBits::eOneTimeSubmit | vk::CommandBufferUsageFlagBits::eRenderPassContinue, &inheritance});
+    ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), static_cast<VkCommandBuffer>(*cmdBuf));
+    cmdBuf.end();
+    recorded.push_back(*cmdBuf);
 }
@@ -1,50 +1,13 @@
 #include "render.hpp"
 
-#include "shaders.hpp"
 #include "utils_raii.hpp"
+#include "shader_cache.hpp"
 
 void createShaderModule(VulkanContext& vk, Pipeline& pipeline, vk::ShaderStageFlagBits shaderStage, std::filesystem::path const& path) {
-    std::ifstream shaderFile;
-    shaderFile.open(path);
-
-    if (!shaderFile) {
-        throw std::runtime_error("Failed to open shader file");
-    }
-
-    std::stringstream strStream;
-    strStream << shaderFile.rdbuf();
-    std::string code = strStream.str();
-
-    EShLanguage stage = vk::su::translateShaderStage(shaderStage);
-
-    std::array<const char*, 1> shaderStrings{code.c_str()};
-
-    glslang::TShader shader(stage);
-    shader.setStrings(shaderStrings.data(), 1);
-
-    // Enable SPIR-V and Vulkan rules when parsing GLSL
-    auto messages = static_cast<EShMessages>(EShMsgSpvRules | EShMsgVulkanRules);
-
-    if (!shader.parse(&glslang::DefaultTBuiltInResource, 100, false, messages)) {
-        puts(shader.getInfoLog());
-        puts(shader.getInfoDebugLog());
-        throw std::runtime_error("Failed to parse shader");
-    }
-
-    glslang::TProgram program;
-    program.addShader(&shader);
-
-    if (!program.link(messages)) {
-        puts(shader.getInfoLog());
-        puts(shader.getInfoDebugLog());
-        throw std::runtime_error("Failed to link shader");
-    }
-
-    std::vector<unsigned int> shaderSPV;
-    glslang::GlslangToSpv(*program.getIntermediate(stage), shaderSPV);
+    std::vector<uint32_t> shaderSPV = loadOrCompileSpirv(shaderStage, path);
 
     Shader shaderExt{vk::raii::ShaderModule(*vk.device, vk::ShaderModuleCreateInfo(vk::ShaderModuleCreateFlags(), shaderSPV))};
-    SpvReflectResult result = spvReflectCreateShaderModule(shaderSPV.size() * sizeof(unsigned int), shaderSPV.data(), &shaderExt.reflect);
+    SpvReflectResult result = spvReflectCreateShaderModule(shaderSPV.size() * sizeof(uint32_t), shaderSPV.data(), &shaderExt.reflect);
     if (result != SPV_REFLECT_RESULT_SUCCESS) {
         throw std::runtime_error("Failed to reflect shader module");
     }
@@ -54,25 +17,31 @@ void createShaderModule(VulkanContext& vk, Pipeline& pipeline, vk::ShaderStageFl
 
 void createSwapChain(VulkanContext& vk) {
     auto [graphicsFamilyIdx, presentFamilyIdx] = vk::raii::su::findGraphicsAndPresentQueueFamilyIndex(*vk.physDev, *vk.surfData->surface);
-    vk.swapChainData.reset();
-    vk.swapChainData = vk::raii::su::SwapChainData(
+    // Framebuffers reference the old image views, so they have to go first
+    vk.framebufs.clear();
+    // Handing over the old swap chain lets the driver reuse its resources, it is destroyed once replaced below
+    vk::raii::su::SwapChainData swapChainData(
             *vk.physDev,
             *vk.device,
             *vk.surfData->surface,
             vk.surfData->extent,
             vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc,
-            {},
+            vk.swapChainData ? &*vk.swapChainData->swapChain : nullptr,
             graphicsFamilyIdx,
             presentFamilyIdx
     );
+    vk.swapChainData = std::move(swapChainData);
     vk.depthBufferData.reset();
     vk.depthBufferData = vk::raii::su::DepthBufferData(*vk.physDev, *vk.device, vk::raii::su::pickDepthFormat(*vk.physDev), vk.surfData->extent);
-    vk.renderPass.reset();
-    vk.renderPass = vk::raii::su::makeRenderPass(
-            *vk.device,
-            vk::su::pickSurfaceFormat(vk.physDev->getSurfaceFormatsKHR(**vk.surfData->surface)).format,
-            vk.depthBufferData->format
-    );
+    // Pipelines are baked against the render pass, which only depends on the formats and not the extent
+    // Keeping it means pipelines, descriptor sets and textures all survive a resize
+    if (!vk.renderPass || vk.renderPassColorFormat != vk.swapChainData->colorFormat || vk.renderPassDepthFormat != vk.depthBufferData->format) {
+        vk.modelPipelines.clear();
+        vk.renderPass.reset();
+        vk.renderPass = vk::raii::su::makeRenderPass(*vk.device, vk.swapChainData->colorFormat, vk.depthBufferData->format);
+        vk.renderPassColorFormat = vk.swapChainData->colorFormat;
+        vk.renderPassDepthFormat = vk.depthBufferData->format;
+    }
     vk.framebufs = vk::raii::su::makeFramebuffers(
             *vk.device,
             *vk.renderPass,
@@ -80,6 +49,27 @@ void createSwapChain(VulkanContext& vk) {
             &*vk.depthBufferData->imageView,
             vk.surfData->extent
     );
+    // The image count may change with the swap chain, and nothing waits on the old semaphores anymore once the device is idle
+    vk.renderDoneSems.clear();
+    for (size_t i = 0; i < vk.swapChainData->images.size(); ++i) {
+        vk.renderDoneSems.emplace_back(*vk.device, vk::SemaphoreCreateInfo());
+    }
+}
+
+vk::DeviceSize dynamicUniformSize(DynamicUniform dynamicUniform) {
+    switch (dynamicUniform) {
+        case DynamicUniform::Camera:
+            return sizeof(CameraUpload);
+        case DynamicUniform::Scene:
+            return sizeof(SceneUpload);
+        case DynamicUniform::Instances:
+        case DynamicUniform::Materials:
+        case DynamicUniform::InstanceIndices:
+            // Per instance arrays run from the dynamic offset to the end of the buffer
+            return VK_WHOLE_SIZE;
+        default:
+            throw std::runtime_error("Unknown dynamic uniform");
+    }
 }
 
 //bool ends_with(std::string_view value, std::string_view ending) {
@@ -93,11 +83,10 @@ void createShaderPipeline(VulkanContext& vk, Pipeline& pipeline) {
     createShaderModule(vk, pipeline, vk::ShaderStageFlagBits::eVertex, shadersPath / "pbr.vert");
     createShaderModule(vk, pipeline, vk::ShaderStageFlagBits::eFragment, shadersPath / "pbr.frag");
 
-    auto uboAlignment = static_cast<uint32_t>(vk.physDev->getProperties().limits.minUniformBufferOffsetAlignment);
-    vk.modelUpload.resize(uboAlignment, 16);
-    vk.materialUpload.resize(uboAlignment, 16);
-
     uint32_t totalUniformCount = 0;
+    std::map<std::pair<uint32_t, uint32_t>, std::pair<vk::DescriptorType, DynamicUniform>> dynamicBindings;
+    // Stages share a binding by (set, binding) alone, so two different buffers declared there would silently alias
+    std::map<std::pair<uint32_t, uint32_t>, std::string> bindingNames;
     // set -> ((stage, descType) -> count)
     std::vector<std::vector<vk::DescriptorSetLayoutBinding>> setBindings(3);
     for (Shader& shader: pipeline.shaders) {
@@ -120,10 +109,20 @@ void createShaderPipeline(VulkanContext& vk, Pipeline& pipeline) {
             SpvReflectDescriptorBinding* binding = shader.bindingsReflect[bind];
             auto descType = static_cast<vk::DescriptorType>(binding->descriptor_type);
             std::string_view name(binding->name);
-            if (descType == vk::DescriptorType::eUniformBuffer && DynamicNames.contains(name)) {
-                // nothing in the shader marks a uniform as dynamic, so we have to infer it from the name
-                descType = vk::DescriptorType::eUniformBufferDynamic;
+            auto [nameIt, isNewName] = bindingNames.try_emplace(std::pair{binding->set, binding->binding}, name);
+            if (!isNewName && nameIt->second != name) {
+                throw std::runtime_error("Shader stages declare both " + nameIt->second + " and " + std::string{name} +
+                                         " at set " + std::to_string(binding->set) + " binding " + std::to_string(binding->binding));
+            }
+            auto dynamicIt = DynamicNames.find(name);
+            if (dynamicIt != DynamicNames.end() &&
+                (descType == vk::DescriptorType::eUniformBuffer || descType == vk::DescriptorType::eStorageBuffer)) {
+                // nothing in the shader marks a buffer as dynamic, so we have to infer it from the name
+                descType = descType == vk::DescriptorType::eUniformBuffer
+                           ? vk::DescriptorType::eUniformBufferDynamic
+                           : vk::DescriptorType::eStorageBufferDynamic;
                 binding->descriptor_type = static_cast<SpvReflectDescriptorType>(descType);
+                dynamicBindings.emplace(std::pair{binding->set, binding->binding}, std::pair{descType, dynamicIt->second});
             }
             totalUniformCount++;
             auto& bindings = setBindings[binding->set];
@@ -143,6 +142,11 @@ void createShaderPipeline(VulkanContext& vk, Pipeline& pipeline) {
 //        }
     }
 
+    pipeline.dynamicBindings.clear();
+    for (auto [bindId, dynamic]: dynamicBindings) {
+        pipeline.dynamicBindings.push_back({bindId.first, bindId.second, dynamic.first, dynamic.second});
+    }
+
     pipeline.descSetLayouts.clear();
     pipeline.descSetLayouts.reserve(setBindings.size());
     for (auto& bindings: setBindings)
@@ -156,80 +160,78 @@ void createShaderPipeline(VulkanContext& vk, Pipeline& pipeline) {
     vk::PipelineLayoutCreateInfo pipelineLayoutCreateInfo{{}, proxyDescSetLayouts, {}};
     pipeline.layout = vk::raii::PipelineLayout{*vk.device, pipelineLayoutCreateInfo};
 
-    pipeline.descSets = vk::raii::DescriptorSets{*vk.device, {**vk.descriptorPool, proxyDescSetLayouts}};
     std::vector<vk::DescriptorBufferInfo> descBufInfos;
     std::vector<vk::WriteDescriptorSet> writeDescSets;
     std::vector<vk::CopyDescriptorSet> copyDescSets;
     std::vector<vk::DescriptorImageInfo> descImgInfos;
-    descBufInfos.reserve(totalUniformCount);
-    writeDescSets.reserve(totalUniformCount);
-    copyDescSets.reserve(totalUniformCount);
-    descImgInfos.reserve(totalUniformCount);
-    for (Shader& shader: pipeline.shaders) {
-        for (uint32_t bind = 0; bind < shader.bindCount; ++bind) {
-            SpvReflectDescriptorBinding const* binding = shader.bindingsReflect[bind];
-            auto descType = static_cast<vk::DescriptorType>(binding->descriptor_type);
-            vk::raii::DescriptorSet& descSet = pipeline.descSets[binding->set];
-            std::string_view name(binding->name);
-            std::pair<uint32_t, uint32_t> bindId{binding->set, binding->binding};
-            switch (descType) {
-                case vk::DescriptorType::eUniformBufferDynamic: {
-                    vk::DeviceSize size = name == "model" ? vk.modelUpload.mem_size() : vk.materialUpload.mem_size();
-                    vk::DeviceSize stride = name == "model" ? vk.modelUpload.block_size() : vk.materialUpload.block_size();
-                    auto [it, _] = pipeline.uniforms.emplace(bindId, vk::raii::su::BufferData{*vk.physDev, *vk.device, size,
-                                                                                              vk::BufferUsageFlagBits::eUniformBuffer});
-                    descBufInfos.emplace_back(**it->second.buffer, 0, stride);
-                    writeDescSets.emplace_back(*descSet, binding->binding, 0, 1,
-                                               vk::DescriptorType::eUniformBufferDynamic, nullptr, &descBufInfos.back());
-                    break;
-                }
-                case vk::DescriptorType::eUniformBuffer: {
-                    vk::DeviceSize size = name == "camera" ? sizeof(vk.cameraUpload) : sizeof(vk.sceneUpload);
-                    auto [it, _] = pipeline.uniforms.emplace(bindId, vk::raii::su::BufferData{*vk.physDev, *vk.device, size,
-                                                                                              vk::BufferUsageFlagBits::eUniformBuffer});
-                    descBufInfos.emplace_back(**it->second.buffer, 0, VK_WHOLE_SIZE);
-                    writeDescSets.emplace_back(*descSet, binding->binding, 0, 1, vk::DescriptorType::eUniformBuffer, nullptr, &descBufInfos.back());
-                    break;
-                }
-                case vk::DescriptorType::eCombinedImageSampler: {
-                    switch (binding->image.dim) {
-                        case SpvDim2D: {
-                            vk::raii::su::TextureData texData{*vk.physDev, *vk.device};
-                            // Upload image to the GPU
-                            vk::raii::su::oneTimeSubmit(vk.cmdBufs->front(), *vk.graphicsQueue,
-                                                        [&texData](vk::raii::CommandBuffer const& cmdBuf) {
-                                                            texData.setImage(cmdBuf, vk::su::MonochromeImageGenerator({255, 255, 255}));
-                                                        });
-
-                            auto [it, _] = vk.textures.emplace(binding->set + binding->binding * 1024, std::move(texData));
-                            descImgInfos.emplace_back(*it->second.sampler, **it->second.imageData->imageView,
-                                                      vk::ImageLayout::eShaderReadOnlyOptimal);
-                            writeDescSets.emplace_back(*descSet, binding->binding, 0,
-                                                       vk::DescriptorType::eCombinedImageSampler, descImgInfos.back(), nullptr, nullptr);
-                            break;
-                        }
-                        case SpvDimCube: {
-                            CubeMapData cubeData{*vk.physDev, *vk.device};
-                            vk::raii::su::oneTimeSubmit(vk.cmdBufs->front(), *vk.graphicsQueue,
-                                                        [&cubeData, &vk](vk::raii::CommandBuffer const& cmdBuf) {
-                                                            cubeData.setImage(*vk.device, cmdBuf, SkyboxImageGenerator());
-                                                        });
-
-                            auto [it, _] = vk.cubeMaps.emplace(binding->set + binding->binding * 1024, std::move(cubeData));
-                            descImgInfos.emplace_back(*it->second.sampler, **it->second.imageData->imageView,
-                                                      vk::ImageLayout::eShaderReadOnlyOptimal);
-                            writeDescSets.emplace_back(*descSet, binding->binding, 0,
-                                                       vk::DescriptorType::eCombinedImageSampler, descImgInfos.back(), nullptr, nullptr);
-                            break;
-                        }
-                        default: {
-                            throw std::runtime_error("Unsupported image dimension type: " + std::to_string(binding->image.dim));
+    // Infos are referenced by pointer in the writes, so these must never reallocate
+    descBufInfos.reserve(totalUniformCount * vk.framesInFlight);
+    writeDescSets.reserve(totalUniformCount * vk.framesInFlight);
+    copyDescSets.reserve(totalUniformCount * vk.framesInFlight);
+    descImgInfos.reserve(totalUniformCount * vk.framesInFlight);
+    pipeline.frames.clear();
+    pipeline.frames.reserve(vk.framesInFlight);
+    for (uint32_t frameIdx = 0; frameIdx < vk.framesInFlight; ++frameIdx) {
+        PipelineFrame& frame = pipeline.frames.emplace_back(
+                PipelineFrame{vk::raii::DescriptorSets{*vk.device, {**vk.descriptorPool, proxyDescSetLayouts}}}
+        );
+        for (Shader& shader: pipeline.shaders) {
+            for (uint32_t bind = 0; bind < shader.bindCount; ++bind) {
+                SpvReflectDescriptorBinding const* binding = shader.bindingsReflect[bind];
+                auto descType = static_cast<vk::DescriptorType>(binding->descriptor_type);
+                vk::raii::DescriptorSet& descSet = frame.descSets[binding->set];
+                switch (descType) {
+                    case vk::DescriptorType::eUniformBufferDynamic:
+                    case vk::DescriptorType::eStorageBufferDynamic: {
+                        // Written lazily by updateDynamicDescriptors since the upload buffer can be recreated when it grows
+                        break;
+                    }
+                    case vk::DescriptorType::eCombinedImageSampler: {
+                        // Textures are only read by the GPU, so all frames can share them
+                        asset_handle_t texHandle = binding->set + binding->binding * 1024;
+                        switch (binding->image.dim) {
+                            case SpvDim2D: {
+                                auto it = vk.textures.find(texHandle);
+                                if (it == vk.textures.end()) {
+                                    vk::raii::su::TextureData texData{*vk.physDev, *vk.device};
+                                    // Upload image to the GPU
+                                    vk::raii::su::oneTimeSubmit(*vk.device, *vk.cmdPool, *vk.graphicsQueue,
+                                                                [&texData](vk::raii::CommandBuffer const& cmdBuf) {
+                                                                    texData.setImage(cmdBuf, vk::su::MonochromeImageGenerator({255, 255, 255}));
+                                                                });
+                                    it = vk.textures.emplace(texHandle, std::move(texData)).first;
+                                }
+                                descImgInfos.emplace_back(*it->second.sampler, **it->second.imageData->imageView,
+                                                          vk::ImageLayout::eShaderReadOnlyOptimal);
+                                writeDescSets.emplace_back(*descSet, binding->binding, 0,
+                                                           vk::DescriptorType::eCombinedImageSampler, descImgInfos.back(), nullptr, nullptr);
+                                break;
+                            }
+                            case SpvDimCube: {
+                                auto it = vk.cubeMaps.find(texHandle);
+                                if (it == vk.cubeMaps.end()) {
+                                    CubeMapData cubeData{*vk.physDev, *vk.device};
+                                    vk::raii::su::oneTimeSubmit(*vk.device, *vk.cmdPool, *vk.graphicsQueue,
+                                                                [&cubeData, &vk](vk::raii::CommandBuffer const& cmdBuf) {
+                                                                    cubeData.setImage(*vk.device, cmdBuf, SkyboxImageGenerator());
+                                                                });
+                                    it = vk.cubeMaps.emplace(texHandle, std::move(cubeData)).first;
+                                }
+                                descImgInfos.emplace_back(*it->second.sampler, **it->second.imageData->imageView,
+                                                          vk::ImageLayout::eShaderReadOnlyOptimal);
+                                writeDescSets.emplace_back(*descSet, binding->binding, 0,
+                                                           vk::DescriptorType::eCombinedImageSampler, descImgInfos.back(), nullptr, nullptr);
+                                break;
+                            }
+                            default: {
+                                throw std::runtime_error("Unsupported image dimension type: " + std::to_string(binding->image.dim));
+                            }
                         }
+                        break;
+                    }
+                    default: {
+                        throw std::runtime_error("Unsupported uniform descriptor type: " + vk::to_string(descType));
                     }
-                    break;
-                }
-                default: {
-                    throw std::runtime_error("Unsupported uniform descriptor type: " + vk::to_string(descType));
                 }
             }
         }
@@ -252,21 +254,29 @@ void createShaderPipeline(VulkanContext& vk, Pipeline& pipeline) {
         for (auto& c: name) c = static_cast<char>(std::toupper(c));
         vk::Format format{};
         // vec3 and vec4 have identical alignment so we can treat them as same Vulkan type
-        // TODO is this really okay?
+        // vec3 is padded out to a full vec4 in the vertex buffer so the fetch never reads into the next attribute
+        uint32_t slotCompCount = compCount;
         if ((compCount == 3 || compCount == 4) && elemSize == sizeof(float) * 8) {
             format = vk::Format::eR32G32B32A32Sfloat;
+            slotCompCount = 4;
         } else if (compCount == 2 && elemSize == sizeof(float) * 8) {
             format = vk::Format::eR32G32Sfloat;
         }
-        uint32_t size = sizeof(float) * compCount;
+        uint32_t size = sizeof(float) * slotCompCount;
 
         vertexAttrPairs.emplace_back(format, vertexAttrOffset);
-        auto [it, wasAdded] = vertexShader.vertAttrs.emplace(layout, VertexAttr{name, format, size, vertexAttrOffset});
+        auto [it, wasAdded] = vertexShader.vertAttrs.emplace(layout, VertexAttr{name, format, size, vertexAttrOffset, compCount});
         GAME_ASSERT(wasAdded);
         vertexAttrOffset += size;
     }
     vertexShader.vertAttrStride = vertexAttrOffset;
 
+    // The driver reports whether the pipeline came out of the cache, which is how we track the hit rate
+    vk::PipelineCreationFeedbackEXT creationFeedback{};
+    std::array<vk::PipelineCreationFeedbackEXT, 2> stageFeedbacks{};
+    vk::PipelineCreationFeedbackCreateInfoEXT feedbackInfo(&creationFeedback, stageFeedbacks);
+    PipelineCacheStats& cacheStats = vk.pipelineCacheStats;
+
     pipeline.value = vk::raii::su::makeGraphicsPipeline(
             *vk.device,
             *vk.pipelineCache,
@@ -279,16 +289,41 @@ void createShaderPipeline(VulkanContext& vk, Pipeline& pipeline) {
             vk::FrontFace::eCounterClockwise,
             true,
             *pipeline.layout,
-            *vk.renderPass
+            *vk.renderPass,
+            cacheStats.isSupported ? &feedbackInfo : nullptr
     );
+    if (cacheStats.isSupported && (creationFeedback.flags & vk::PipelineCreationFeedbackFlagBitsEXT::eValid)) {
+        bool isHit = static_cast<bool>(creationFeedback.flags & vk::PipelineCreationFeedbackFlagBitsEXT::eApplicationPipelineCacheHit);
+        (isHit ? cacheStats.hits : cacheStats.misses)++;
+    }
 }
 
-void recreatePipeline(VulkanContext& vk) {
-    vk.device->waitIdle();
+void updateDynamicDescriptors(VulkanContext& vk, Pipeline& pipeline, uint32_t frameIdx) {
+    PipelineFrame& pipelineFrame = pipeline.frames[frameIdx];
+    UploadBuffer const& uploads = vk.frames[frameIdx].uploads;
+    std::vector<vk::DescriptorBufferInfo> descBufInfos;
+    std::vector<vk::WriteDescriptorSet> writeDescSets;
+    descBufInfos.reserve(pipeline.dynamicBindings.size());
+    writeDescSets.reserve(pipeline.dynamicBindings.size());
+    for (DynamicBinding const& dynamicBinding: pipeline.dynamicBindings) {
+        // Points at the start of the frame's upload buffer, the dynamic offset selects the actual data when binding
+        descBufInfos.emplace_back(uploads.buffer(), 0, dynamicUniformSize(dynamicBinding.uniform));
+        writeDescSets.emplace_back(*pipelineFrame.descSets[dynamicBinding.set], dynamicBinding.binding, 0, 1,
+                                   dynamicBinding.type, nullptr, &descBufInfos.back());
+    }
+    vk.device->updateDescriptorSets(writeDescSets, nullptr);
+    pipelineFrame.uploadGeneration = uploads.generation();
+}
+
+void recreateSwapChain(VulkanContext& vk) {
     int width, height;
     glfwGetFramebufferSize(vk.surfData->window.handle, &width, &height);
+    // A minimized window has no area to render to, wait until it comes back
+    while (width == 0 || height == 0) {
+        glfwWaitEvents();
+        glfwGetFramebufferSize(vk.surfData->window.handle, &width, &height);
+    }
+    vk.device->waitIdle();
     vk.surfData->extent = vk::Extent2D(width, height);
-    // Force recreation of pipelines, as they depend on the swap chain
-    vk.modelPipelines.clear();
     createSwapChain(vk);
 }
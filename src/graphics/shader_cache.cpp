@@ -0,0 +1,110 @@
+#include "shader_cache.hpp"
+
+#include "hash.hpp"
+#include "shaders.hpp"
+
+// Bump when compile options change so stale blobs are not picked up
+constexpr std::string_view ShaderCacheVersion = "1";
+constexpr uint32_t SpirvMagic = 0x07230203;
+
+std::filesystem::path shaderCacheDir() {
+    return std::filesystem::current_path() / "cache" / "shaders";
+}
+
+std::string readText(std::filesystem::path const& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("Failed to open shader file: " + path.string());
+    }
+    std::stringstream strStream;
+    strStream << file.rdbuf();
+    return strStream.str();
+}
+
+std::optional<std::vector<uint32_t>> tryReadSpirv(std::filesystem::path const& path) {
+    std::error_code err;
+    uintmax_t size = std::filesystem::file_size(path, err);
+    if (err || size == 0 || size % sizeof(uint32_t)) return std::nullopt;
+
+    std::ifstream file(path, std::ios::binary);
+    if (!file) return std::nullopt;
+
+    std::vector<uint32_t> spirv(size / sizeof(uint32_t));
+    file.read(reinterpret_cast<char*>(spirv.data()), static_cast<std::streamsize>(size));
+    if (!file || spirv.front() != SpirvMagic) return std::nullopt;
+
+    return spirv;
+}
+
+void writeSpirv(std::filesystem::path const& path, std::vector<uint32_t> const& spirv) {
+    std::error_code err;
+    std::filesystem::create_directories(path.parent_path(), err);
+    // Write to the side and rename so a crash never leaves a truncated blob behind
+    std::filesystem::path tmpPath = path;
+    tmpPath += ".tmp";
+    {
+        std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<char const*>(spirv.data()), static_cast<std::streamsize>(spirv.size() * sizeof(uint32_t)));
+        if (!file) {
+            std::cerr << "[Shader] Failed to write cache " << path << std::endl;
+            return;
+        }
+    }
+    std::filesystem::rename(tmpPath, path, err);
+    if (err) {
+        std::cerr << "[Shader] Failed to write cache " << path << ": " << err.message() << std::endl;
+    }
+}
+
+std::vector<uint32_t> compileGlsl(vk::ShaderStageFlagBits shaderStage, std::string const& code) {
+    EShLanguage stage = vk::su::translateShaderStage(shaderStage);
+
+    std::array<const char*, 1> shaderStrings{code.c_str()};
+
+    glslang::TShader shader(stage);
+    shader.setStrings(shaderStrings.data(), 1);
+
+    // Enable SPIR-V and Vulkan rules when parsing GLSL
+    auto messages = static_cast<EShMessages>(EShMsgSpvRules | EShMsgVulkanRules);
+
+    if (!shader.parse(&glslang::DefaultTBuiltInResource, 100, false, messages)) {
+        puts(shader.getInfoLog());
+        puts(shader.getInfoDebugLog());
+        throw std::runtime_error("Failed to parse shader");
+    }
+
+    glslang::TProgram program;
+    program.addShader(&shader);
+
+    if (!program.link(messages)) {
+        puts(shader.getInfoLog());
+        puts(shader.getInfoDebugLog());
+        throw std::runtime_error("Failed to link shader");
+    }
+
+    std::vector<uint32_t> shaderSPV;
+    glslang::GlslangToSpv(*program.getIntermediate(stage), shaderSPV);
+    return shaderSPV;
+}
+
+std::vector<uint32_t> loadOrCompileSpirv(vk::ShaderStageFlagBits stage, std::filesystem::path const& path) {
+    std::error_code err;
+    std::filesystem::path builtPath = path;
+    builtPath += ".spv";
+    auto builtTime = std::filesystem::last_write_time(builtPath, err);
+    if (!err && builtTime >= std::filesystem::last_write_time(path)) {
+        if (auto spirv = tryReadSpirv(builtPath)) return *spirv;
+    }
+
+    std::string code = readText(path);
+    uint64_t hash = fnv1a64(code, fnv1a64(vk::to_string(stage), fnv1a64(ShaderCacheVersion)));
+    std::stringstream name;
+    name << path.filename().string() << '-' << std::hex << std::setw(16) << std::setfill('0') << hash << ".spv";
+    std::filesystem::path cachePath = shaderCacheDir() / name.str();
+    if (auto spirv = tryReadSpirv(cachePath)) return *spirv;
+
+    std::vector<uint32_t> spirv = compileGlsl(stage, code);
+    writeSpirv(cachePath, spirv);
+    std::cout << "[Shader] Compiled " << path.filename() << std::endl;
+    return spirv;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "game_pch.hpp"
+
+#include <vulkan/vulkan.hpp>
+
+/**
+ * @brief Gets SPIR-V for a GLSL shader, only running glslang when nothing up to date is on disk.
+ *
+ * Looks in order for:
+ *  - A .spv next to the source emitted by the build, if it is newer than the source
+ *  - A blob in the runtime cache keyed by a hash of the source text and stage
+ * Anything compiled here is written to the runtime cache for next time.
+ */
+std::vector<uint32_t> loadOrCompileSpirv(vk::ShaderStageFlagBits stage, std::filesystem::path const& path);
@@ -4,6 +4,9 @@
 
 #include "math.hpp"
 
+// Near and far planes of the camera, nothing further than the far one is drawn
+static constexpr double ZNear = 0.1, ZFar = 100.0;
+
 // Vulkan clip space has inverted y and half z
 static constexpr mat4 ClipMat = {
         vec4{1.0, 0.0, 0.0, 0.0},
@@ -62,13 +65,12 @@ static mat4 calcProj(vk::Extent2D const& extent) {
     constexpr double rad = edyn::to_radians(45.0);
     double h = std::cos(0.5 * rad) / std::sin(0.5 * rad);
     double w = h * static_cast<double>(extent.height) / static_cast<double>(extent.width);
-    constexpr double zNear = 0.1, zFar = 100.0;
     mat4 proj{};
     proj[0][0] = w;
     proj[1][1] = h;
-    proj[2][2] = zFar / (zNear - zFar);
+    proj[2][2] = ZFar / (ZNear - ZFar);
     proj[2][3] = -1.0;
-    proj[3][2] = -(zFar * zNear) / (zFar - zNear);
+    proj[3][2] = -(ZFar * ZNear) / (ZFar - ZNear);
     return proj;
 }
 
@@ -0,0 +1,37 @@
+#include "upload_buffer.hpp"
+
+UploadBuffer::UploadBuffer(vk::raii::PhysicalDevice const& physDev, vk::raii::Device const& device,
+                           vk::DeviceSize capacity, vk::DeviceSize alignment, vk::BufferUsageFlags usage)
+        : mAlignment(std::max(alignment, vk::DeviceSize{1})), mUsage(usage) {
+    GAME_ASSERT((mAlignment & (mAlignment - 1)) == 0);
+    allocate(physDev, device, capacity);
+}
+
+void UploadBuffer::allocate(vk::raii::PhysicalDevice const& physDev, vk::raii::Device const& device, vk::DeviceSize capacity) {
+    // Release the old memory first so we never hold both at once
+    mMapped = nullptr;
+    mBufData.reset();
+    mBufData.emplace(physDev, device, capacity, mUsage);
+    mCapacity = capacity;
+    mHead = 0;
+    mGeneration++;
+    // Host coherent memory does not need flushing, so we can keep it mapped and write to it whenever
+    mMapped = static_cast<std::byte*>(mBufData->deviceMemory->mapMemory(0, mCapacity));
+}
+
+bool UploadBuffer::reserve(vk::raii::PhysicalDevice const& physDev, vk::raii::Device const& device, vk::DeviceSize size) {
+    GAME_ASSERT(mHead == 0);
+    if (size <= mCapacity) return false;
+
+    allocate(physDev, device, std::max(size, mCapacity * 2));
+    return true;
+}
+
+UploadAllocation UploadBuffer::alloc(vk::DeviceSize size) {
+    vk::DeviceSize offset = alignUp(mHead);
+    if (offset + size > mCapacity) {
+        throw std::runtime_error("Upload buffer out of space: " + std::to_string(offset + size) + " > " + std::to_string(mCapacity));
+    }
+    mHead = offset + size;
+    return {static_cast<uint32_t>(offset), mMapped + offset};
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "game_pch.hpp"
+
+#include <vulkan/vulkan_raii.hpp>
+
+#include "utils_raii.hpp"
+
+struct UploadAllocation {
+    uint32_t offset;
+    std::byte* data;
+};
+
+/**
+ * @brief Linear allocator over host coherent memory that stays mapped for its whole lifetime.
+ *
+ * Each frame in flight owns one, so it can be reset as soon as that frame's fence has signaled.
+ * Every allocation is aligned so its offset can be handed directly to a dynamic descriptor.
+ */
+class UploadBuffer {
+private:
+    std::optional<vk::raii::su::BufferData> mBufData;
+    std::byte* mMapped = nullptr;
+    vk::DeviceSize mCapacity{}, mAlignment{}, mHead{};
+    vk::BufferUsageFlags mUsage;
+    // Bumped every time the underlying buffer is recreated, zero is never valid
+    uint32_t mGeneration = 0;
+
+    void allocate(vk::raii::PhysicalDevice const& physDev, vk::raii::Device const& device, vk::DeviceSize capacity);
+
+public:
+    UploadBuffer(vk::raii::PhysicalDevice const& physDev, vk::raii::Device const& device,
+                 vk::DeviceSize capacity, vk::DeviceSize alignment, vk::BufferUsageFlags usage);
+
+    void reset() {
+        mHead = 0;
+    }
+
+    /**
+     * @brief Makes sure at least size bytes can be allocated, growing geometrically if not.
+     *        Must be called before any allocations this frame since growing discards the old contents.
+     * @return  Whether the buffer was recreated, in which case descriptors pointing to it must be rewritten
+     */
+    bool reserve(vk::raii::PhysicalDevice const& physDev, vk::raii::Device const& device, vk::DeviceSize size);
+
+    [[nodiscard]] vk::DeviceSize alignUp(vk::DeviceSize size) const {
+        return (size + mAlignment - 1) & ~(mAlignment - 1);
+    }
+
+    UploadAllocation alloc(vk::DeviceSize size);
+
+    template<typename T>
+    uint32_t push(T const& value) {
+        UploadAllocation allocation = alloc(sizeof(T));
+        std::memcpy(allocation.data, &value, sizeof(T));
+        return allocation.offset;
+    }
+
+    [[nodiscard]] vk::Buffer buffer() const {
+        return **mBufData->buffer;
+    }
+
+    [[nodiscard]] vk::DeviceSize capacity() const {
+        return mCapacity;
+    }
+
+    [[nodiscard]] vk::DeviceSize size() const {
+        return mHead;
+    }
+
+    [[nodiscard]] uint32_t generation() const {
+        return mGeneration;
+    }
+};
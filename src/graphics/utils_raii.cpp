@@ -376,7 +376,8 @@ vk::raii::Pipeline vk::raii::su::makeGraphicsPipeline(vk::raii::Device const& de
                                                       vk::SpecializationInfo const* fragmentShaderSpecializationInfo, uint32_t vertexStride,
                                                       std::vector<std::pair<vk::Format, uint32_t>> const& vertexInputAttributeFormatOffset,
                                                       vk::FrontFace frontFace, bool depthBuffered, vk::raii::PipelineLayout const& pipelineLayout,
-                                                      vk::raii::RenderPass const& renderPass) {
+                                                      vk::raii::RenderPass const& renderPass,
+                                                      void const* pNext) {
     std::array<vk::PipelineShaderStageCreateInfo, 2> pipelineShaderStageCreateInfos = {
             vk::PipelineShaderStageCreateInfo({}, vk::ShaderStageFlagBits::eVertex, *vertexShaderModule, "main",
                                               vertexShaderSpecializationInfo),
@@ -456,6 +457,7 @@ vk::raii::Pipeline vk::raii::su::makeGraphicsPipeline(vk::raii::Device const& de
             *pipelineLayout,
             *renderPass
     );
+    graphicsPipelineCreateInfo.pNext = pNext;
 
     return {device, pipelineCache, graphicsPipelineCreateInfo};
 }
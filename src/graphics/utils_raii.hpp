@@ -255,7 +255,8 @@ namespace vk::raii::su {
                                             vk::FrontFace frontFace,
                                             bool depthBuffered,
                                             vk::raii::PipelineLayout const& pipelineLayout,
-                                            vk::raii::RenderPass const& renderPass);
+                                            vk::raii::RenderPass const& renderPass,
+                                            void const* pNext = nullptr);
 
     vk::raii::Image makeImage(vk::raii::Device const& device);
 
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "game_pch.hpp"
+
+constexpr uint64_t Fnv1aOffsetBasis = 0xcbf29ce484222325;
+constexpr uint64_t Fnv1aPrime = 0x100000001b3;
+
+/** @brief 64-bit FNV-1a, pass a previous result as the seed to hash several pieces as one */
+constexpr uint64_t fnv1a64(std::string_view data, uint64_t seed = Fnv1aOffsetBasis) {
+    uint64_t hash = seed;
+    for (char c: data) {
+        hash ^= static_cast<uint8_t>(c);
+        hash *= Fnv1aPrime;
+    }
+    return hash;
+}
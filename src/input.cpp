@@ -10,6 +10,13 @@ double getAxis(GLFWwindow* glfwWindow, int positiveKey, int negativeKey) {
            (glfwGetKey(glfwWindow, negativeKey) ? -1.0 : 0.0);
 }
 
+void InputPlugin::access(SystemAccess& access) {
+    // GLFW may only be queried from the main thread
+    access.mainThread()
+            .read<LogicWorldAccess, VulkanContext, LocalContext, Player>()
+            .write<Input, UI, WindowContext>();
+}
+
 
 void InputPlugin::execute(App& app) {
     // TODO:arch restructure so it is graphics API agnostic
@@ -37,7 +44,8 @@ void InputPlugin::execute(App& app) {
         vec2 prevMouse = input.cursor;
         glfwGetCursorPos(glfwWindow, &input.cursor.x, &input.cursor.y);
         if (window.isFocused == isFocused && !isUiVisible) {
-            input.cursorDelta = (input.cursor - prevMouse) * 0.005;
+            // Added up until a tick consumes it, frames may run faster than ticks
+            input.cursorDelta += (input.cursor - prevMouse) * 0.005;
         } else { // prevent snapping when tabbing back in
             input.cursorDelta = {};
         }
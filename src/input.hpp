@@ -11,5 +11,7 @@ struct InputSettings {
 
 class InputPlugin : public Plugin {
 public:
+    void access(SystemAccess& access) override;
+
     void execute(App& app) override;
 };
@@ -3,53 +3,78 @@
 #include <imgui.h>
 
 #include "app.hpp"
+#include "math.hpp"
 #include "state.hpp"
+#include "spatial_index.hpp"
 
+// How far away the inspector picks entities the local player looks at
+constexpr scalar PickDistance = 100.0;
 
+
+/** @return Whether the user edited the value */
 template<std::copyable TComp>
-void renderValue(TComp& comp, entt::meta_data const& field, std::string_view name) {
+bool renderValue(TComp& comp, entt::meta_data const& field, std::string_view name) {
     entt::meta_type const& fieldType = field.type();
     char const* nameCStr = name.data();
+    bool isEdited = false;
     if (fieldType == entt::resolve<double>()) {
         auto d = field.get(comp).template cast<double>();
-        ImGui::InputDouble(nameCStr, &d);
+        isEdited = ImGui::InputDouble(nameCStr, &d);
         field.set(comp, d);
     } else if (fieldType == entt::resolve<int>()) {
         auto i = field.get(comp).template cast<int>();
-        ImGui::InputInt(nameCStr, &i);
+        isEdited = ImGui::InputInt(nameCStr, &i);
         field.set(comp, i);
     } else if (fieldType == entt::resolve<vec3f>()) {
         auto v = field.get(comp).template cast<vec3f>();
-        ImGui::InputFloat3(nameCStr, &v.x);
+        isEdited = ImGui::InputFloat3(nameCStr, &v.x);
         field.set(comp, v);
     } else if (fieldType == entt::resolve<vec4f>()) {
         auto v = field.get(comp).template cast<vec4f>();
-        ImGui::InputFloat4(nameCStr, &v.x);
+        isEdited = ImGui::InputFloat4(nameCStr, &v.x);
         field.set(comp, v);
     } else if (fieldType == entt::resolve<vec3>()) {
         auto v = field.get(comp).template cast<vec3>();
-        ImGui::InputDouble(nameCStr, &v.x);
-        ImGui::InputDouble(nameCStr, &v.y);
-        ImGui::InputDouble(nameCStr, &v.z);
+        isEdited |= ImGui::InputDouble(nameCStr, &v.x);
+        isEdited |= ImGui::InputDouble(nameCStr, &v.y);
+        isEdited |= ImGui::InputDouble(nameCStr, &v.z);
         field.set(comp, v);
     }
+    return isEdited;
 }
 
 template<std::copyable TComp>
 void renderComponent(App& app, entt::entity ent) {
-    for (auto [compEnt, comp]: app.logicWorld.view<TComp>().each()) {
-        if (compEnt != ent) continue;
+    auto* comp = app.logicWorld.try_get<TComp>(ent);
+    if (!comp) return;
 
-        entt::meta_type const& type = entt::resolve<TComp>();
+    entt::meta_type const& type = entt::resolve<TComp>();
 
-        for (entt::meta_data const& field: type.data()) {
-            entt::meta_prop const& tooltip = field.prop("display_name"_hs);
-            if (!tooltip) continue;
+    bool isEdited = false;
+    for (entt::meta_data const& field: type.data()) {
+        entt::meta_prop const& tooltip = field.prop("display_name"_hs);
+        if (!tooltip) continue;
 
-            auto name = tooltip.value().cast<std::string_view>();
-            renderValue(comp, field, name);
-        }
+        auto name = tooltip.value().cast<std::string_view>();
+        isEdited |= renderValue(*comp, field, name);
+    }
+    // Edits are made in place, so let anyone observing the component know
+    if (isEdited) app.logicWorld.patch<TComp>(ent);
+}
+
+/** @brief Casts from the local player's eye along where it looks, ignoring the player itself */
+std::optional<RayHit> pickAimed(World const& world) {
+    auto* index = world.ctx().find<SpatialIndex>();
+    if (!index) return std::nullopt;
+
+    std::optional<possesion_id_t> localId = world.ctx().at<LocalContext>().possessionId;
+    for (auto [ent, pos, look, player]: world.view<const Position, const Look, const Player>().each()) {
+        if (player.possessionId != localId) continue;
+
+        vec3 dir = edyn::rotate(fromEuler(look), edyn::vector3_y);
+        return index->raycast(pos, dir, PickDistance, [ent](entt::entity hit) { return hit != ent; });
     }
+    return std::nullopt;
 }
 
 void renderImGuiInspector(App& app) {
@@ -63,8 +88,13 @@ void renderImGuiInspector(App& app) {
     static bool isOpen = true;
     isOpen = ImGui::Begin("Entity Inspector", &isOpen);
     if (isOpen) {
+        std::optional<RayHit> aimed = pickAimed(app.logicWorld);
+        if (aimed) {
+            ImGui::Text("Aimed at #%u, %.1f m away", static_cast<uint32_t>(aimed->ent), aimed->distance);
+        }
         for (entt::entity const& ent: sortedEntities) {
-            if (ImGui::TreeNode(&ent, "#%u", ent)) {
+            bool isAimed = aimed && aimed->ent == ent;
+            if (ImGui::TreeNode(&ent, isAimed ? "#%u (aimed)" : "#%u", ent)) {
 //                for (auto [possessionId, storage]: app.logicWorld.storage()) {
 //                    if (storage.contains(ent)) {
 //                        if (possessionId == "position"_hs) {d
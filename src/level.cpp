@@ -0,0 +1,58 @@
+#include "level.hpp"
+
+#include "app.hpp"
+#include "state.hpp"
+
+void LevelPlugin::build(App& app) {
+    World& world = app.logicWorld;
+    auto pickupEnt = world.create();
+    world.emplace<ItemPickup>(pickupEnt, "M4"_hs);
+    world.emplace<ModelHandle>(pickupEnt, "M4"_hs);
+
+    auto floor_def = edyn::rigidbody_def();
+    floor_def.kind = edyn::rigidbody_kind::rb_static;
+    floor_def.material->restitution = 1;
+    floor_def.material->friction = 0.5;
+    floor_def.shape = edyn::plane_shape{.normal = {0, 0, 1}};
+    edyn::make_rigidbody(world, floor_def);
+
+    for (int i = 0; i < 3; ++i) {
+        auto cubeEnt = world.create();
+        world.emplace<ModelHandle>(cubeEnt, "Cube"_hs);
+        world.emplace<Position>(cubeEnt);
+        world.emplace<Orientation>(cubeEnt, 1.0, 0.0, 0.0, 0.0);
+        Material material{
+                .baseColorFactor = {1.0f, 1.0f, 1.0f, 1.0f},
+                .emissiveFactor = {0.0f, 0.0f, 0.0f, 0.0f},
+                .diffuseFactor = {1.0f, 1.0f, 1.0f, 1.0f},
+                .specularFactor = {0.0f, 0.0f, 0.0f, 0.0f},
+                .workflow = static_cast<float>(PBRWorkflows::MetallicRoughness),
+                .baseColorTextureSet = 0,
+                .physicalDescriptorTextureSet = 1,
+                .normalTextureSet = 2,
+                .occlusionTextureSet = 3,
+                .emissiveTextureSet = 4,
+                .metallicFactor = 0.0f,
+                .roughnessFactor = 0.2f,
+                .alphaMask = 0.0f,
+                .alphaMaskCutoff = 0.0f
+        };
+        world.emplace<Material>(cubeEnt, material);
+    }
+}
+
+void LevelPlugin::access(SystemAccess& access) {
+    access.read<LogicWorldAccess, SimulationClock>().write<Position>();
+}
+
+void LevelPlugin::execute(App& app) {
+    auto& clock = app.globalCtx.at<SimulationClock>();
+    clock_delta_t elapsed = clock.tickDelta * clock.tick;
+    auto modelView = app.logicWorld.view<Position, Orientation, Material, ModelHandle>();
+    int i = -1;
+    for (auto [ent, pos, orien, material, modelHandle]: modelView.each()) {
+        scalar add = std::cos(sec_t(elapsed).count());
+        scalar x_pos = i++ * 3.0;
+        app.logicWorld.emplace_or_replace<Position>(ent, x_pos, 16.0, add - 1);
+    }
+}
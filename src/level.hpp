@@ -0,0 +1,20 @@
+#pragma once
+
+#include "game_pch.hpp"
+
+#include "plugin.hpp"
+
+/**
+ * @brief Creates the level when built and animates it each tick.
+ *        Clients and the dedicated server both add it, so their logic worlds hold the same level.
+ *        Must be built after physics, which the level's bodies are created in,
+ *        and after anything that observes the logic world, since the level is created right away.
+ */
+class LevelPlugin : public Plugin {
+public:
+    void build(App& app) override;
+
+    void access(SystemAccess& access) override;
+
+    void execute(App& app) override;
+};
@@ -40,6 +40,19 @@ constexpr mat4 transpose(mat4 const& m) noexcept {
     return {m.column(0), m.column(1), m.column(2), m.column(3)};
 }
 
+// Same order as GLSL, so the right hand side is applied first
+constexpr mat4 operator*(mat4 const& a, mat4 const& b) noexcept {
+    mat4 m{};
+    for (size_t i = 0; i < 4; ++i) {
+        m[i] = a[0] * b[i][0] + a[1] * b[i][1] + a[2] * b[i][2] + a[3] * b[i][3];
+    }
+    return m;
+}
+
+constexpr vec4 operator*(mat4 const& m, vec4 const& v) noexcept {
+    return m[0] * v.x + m[1] * v.y + m[2] * v.z + m[3] * v.w;
+}
+
 inline constexpr mat4 matrix4x4_identity{
         vec4{1.0, 0.0, 0.0, 0.0},
         vec4{0.0, 1.0, 0.0, 0.0},
@@ -0,0 +1,103 @@
+#pragma once
+
+#include "game_pch.hpp"
+
+#include <span>
+#include <vector>
+
+/**
+ * @brief Appends little endian values and variable length integers to a byte buffer.
+ *
+ * Variable length integers take seven bits per byte, so small values and small deltas cost a single byte.
+ */
+class ByteWriter {
+private:
+    std::vector<std::byte> mBytes;
+
+public:
+    void clear() {
+        mBytes.clear();
+    }
+
+    template<std::unsigned_integral T>
+    void write(T value) {
+        for (size_t i = 0; i < sizeof(T); ++i) {
+            mBytes.push_back(static_cast<std::byte>(value >> (i * 8)));
+        }
+    }
+
+    void writeVarUint(uint64_t value) {
+        while (value >= 0x80) {
+            mBytes.push_back(static_cast<std::byte>(value | 0x80));
+            value >>= 7;
+        }
+        mBytes.push_back(static_cast<std::byte>(value));
+    }
+
+    /** @brief Zigzag encoded so negative values stay as small as positive ones */
+    void writeVarInt(int64_t value) {
+        writeVarUint((static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+    }
+
+    /** @brief Overwrites a value written earlier, for counts only known once everything after them is written */
+    void patch(size_t offset, uint16_t value) {
+        mBytes.at(offset) = static_cast<std::byte>(value);
+        mBytes.at(offset + 1) = static_cast<std::byte>(value >> 8);
+    }
+
+    /** @brief Drops everything written after size bytes, to take back something that turned out not to fit */
+    void truncate(size_t size) {
+        mBytes.resize(std::min(size, mBytes.size()));
+    }
+
+    [[nodiscard]] size_t size() const {
+        return mBytes.size();
+    }
+
+    [[nodiscard]] std::span<std::byte const> bytes() const {
+        return mBytes;
+    }
+};
+
+/** @brief Reads what ByteWriter wrote, throwing if the data ends early */
+class ByteReader {
+private:
+    std::span<std::byte const> mBytes;
+    size_t mOffset = 0;
+
+    std::byte next() {
+        if (mOffset >= mBytes.size()) throw std::runtime_error("Read past the end of a packet");
+        return mBytes[mOffset++];
+    }
+
+public:
+    explicit ByteReader(std::span<std::byte const> bytes) : mBytes(bytes) {}
+
+    template<std::unsigned_integral T>
+    T read() {
+        T value = 0;
+        for (size_t i = 0; i < sizeof(T); ++i) {
+            value |= static_cast<T>(static_cast<T>(next()) << (i * 8));
+        }
+        return value;
+    }
+
+    uint64_t readVarUint() {
+        uint64_t value = 0;
+        for (uint32_t shift = 0; shift < 64; shift += 7) {
+            auto byte = static_cast<uint64_t>(next());
+            value |= (byte & 0x7F) << shift;
+            if (!(byte & 0x80)) return value;
+        }
+        throw std::runtime_error("Variable length integer is too long");
+    }
+
+    int64_t readVarInt() {
+        uint64_t value = readVarUint();
+        return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+    }
+
+    [[nodiscard]] bool isDone() const {
+        return mOffset == mBytes.size();
+    }
+};
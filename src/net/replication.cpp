@@ -0,0 +1,528 @@
+#include "replication.hpp"
+
+#include "player/player.hpp"
+
+// Bumped whenever the packet layout or the replicated components change
+constexpr uint16_t ProtocolId = 0x4702;
+constexpr tick_t NoBaseline = std::numeric_limits<tick_t>::max();
+// Unacknowledged snapshots kept per client, acks for anything older are ignored
+constexpr size_t MaxInFlightSnapshots = 64;
+constexpr size_t MaxReceivedSnapshots = 64;
+constexpr auto ClientTimeout = 10s;
+constexpr auto HelloInterval = 1s;
+constexpr auto ChallengeTimeout = 5s;
+// Hellos are padded to at least the size of the challenge sent back, so spoofing them amplifies nothing
+constexpr size_t MinHelloBytes = 16;
+
+// Materials are not replicated, mirrored models are drawn with a plain white one
+Material const MirroredMaterial{
+        .baseColorFactor = {1.0f, 1.0f, 1.0f, 1.0f},
+        .emissiveFactor = {0.0f, 0.0f, 0.0f, 0.0f},
+        .diffuseFactor = {1.0f, 1.0f, 1.0f, 1.0f},
+        .specularFactor = {0.0f, 0.0f, 0.0f, 0.0f},
+        .workflow = static_cast<float>(PBRWorkflows::MetallicRoughness),
+        .baseColorTextureSet = 0,
+        .physicalDescriptorTextureSet = 1,
+        .normalTextureSet = 2,
+        .occlusionTextureSet = 3,
+        .emissiveTextureSet = 4,
+        .metallicFactor = 0.0f,
+        .roughnessFactor = 0.2f,
+        .alphaMask = 0.0f,
+        .alphaMaskCutoff = 0.0f
+};
+
+int32_t quantizeValue(entt::meta_any const& value, double step) {
+    auto quantizeFloat = [step](double d) {
+        double steps = std::round(d / step);
+        return static_cast<int32_t>(std::clamp<double>(steps, std::numeric_limits<int32_t>::min(), std::numeric_limits<int32_t>::max()));
+    };
+    if (auto const* d = value.try_cast<const double>()) return quantizeFloat(*d);
+    if (auto const* f = value.try_cast<const float>()) return quantizeFloat(*f);
+    if (auto const* u8 = value.try_cast<const uint8_t>()) return *u8;
+    if (auto const* u16 = value.try_cast<const uint16_t>()) return *u16;
+    // Asset handles are hashes that use every bit, so they travel as their bit pattern
+    if (auto const* u32 = value.try_cast<const uint32_t>()) return static_cast<int32_t>(*u32);
+    if (auto const* i = value.try_cast<const int>()) return *i;
+    throw std::runtime_error("Replicated field has an unsupported type");
+}
+
+template<typename T>
+void setValue(entt::meta_data const& field, T& comp, int32_t value, double step) {
+    entt::meta_type type = field.type();
+    if (type == entt::resolve<double>()) {
+        field.set(comp, static_cast<double>(value) * step);
+    } else if (type == entt::resolve<float>()) {
+        field.set(comp, static_cast<float>(static_cast<double>(value) * step));
+    } else if (type == entt::resolve<uint8_t>()) {
+        field.set(comp, static_cast<uint8_t>(value));
+    } else if (type == entt::resolve<uint16_t>()) {
+        field.set(comp, static_cast<uint16_t>(value));
+    } else if (type == entt::resolve<uint32_t>()) {
+        field.set(comp, static_cast<uint32_t>(value));
+    } else if (type == entt::resolve<int>()) {
+        field.set(comp, static_cast<int>(value));
+    } else {
+        throw std::runtime_error("Replicated field has an unsupported type");
+    }
+}
+
+/** @brief Describes a component by its reflection, so the fields that get sent are the ones registered with entt::meta */
+template<typename T>
+ReplicatedComponent replicate(double step) {
+    ReplicatedComponent component{
+            {}, step, 0,
+            [](World const& world, entt::entity ent) {
+                return world.all_of<T>(ent);
+            },
+            [](ReplicatedComponent const& replicated, World const& world, entt::entity ent, int32_t* values) {
+                T const& comp = world.get<T>(ent);
+                for (size_t fieldIdx = 0; fieldIdx < replicated.fields.size(); ++fieldIdx) {
+                    values[fieldIdx] = quantizeValue(replicated.fields[fieldIdx].get(comp), replicated.step);
+                }
+            },
+            [](ReplicatedComponent const& replicated, World& world, entt::entity ent, int32_t const* values) {
+                T comp = world.all_of<T>(ent) ? world.get<T>(ent) : T{};
+                for (size_t fieldIdx = 0; fieldIdx < replicated.fields.size(); ++fieldIdx) {
+                    setValue(replicated.fields[fieldIdx], comp, values[fieldIdx], replicated.step);
+                }
+                world.emplace_or_replace<T>(ent, comp);
+            },
+            [](World& world, entt::entity ent) {
+                world.remove<T>(ent);
+            },
+    };
+    for (entt::meta_data field: entt::resolve<T>().data()) {
+        component.fields.push_back(field);
+    }
+    if (component.fields.empty()) throw std::runtime_error("Replicated component has no reflected fields");
+    return component;
+}
+
+std::vector<ReplicatedComponent> const& replicatedComponents() {
+    static std::vector<ReplicatedComponent> components = [] {
+        std::vector<ReplicatedComponent> replicated{
+                replicate<Position>(1.0 / 512.0),
+                replicate<Orientation>(1.0 / 16384.0),
+                replicate<LinearVelocity>(1.0 / 256.0),
+                replicate<Look>(1.0 / 4096.0),
+                replicate<ModelHandle>(1.0),
+        };
+        size_t valueCount = 0;
+        for (ReplicatedComponent& component: replicated) {
+            component.valueOffset = valueCount;
+            valueCount += component.fields.size();
+        }
+        GAME_ASSERT(valueCount <= MaxReplicatedValues);
+        GAME_ASSERT(replicated.size() <= 32);
+        return replicated;
+    }();
+    return components;
+}
+
+Snapshot captureSnapshot(World const& world, vec3 const& center, scalar radius, std::vector<entt::entity>& priority) {
+    auto const& components = replicatedComponents();
+    Snapshot snapshot;
+    std::vector<std::pair<scalar, entt::entity>> byDistance;
+    world.each([&](entt::entity ent) {
+        // Anything without a position is not anywhere in particular, so it is always of interest
+        scalar distanceSqr = 0.0;
+        if (auto* pos = world.try_get<Position>(ent)) {
+            distanceSqr = edyn::distance_sqr(*pos, center);
+            if (distanceSqr > radius * radius) return;
+        }
+
+        EntitySnapshot entSnapshot;
+        for (size_t componentIdx = 0; componentIdx < components.size(); ++componentIdx) {
+            ReplicatedComponent const& component = components[componentIdx];
+            if (!component.has(world, ent)) continue;
+
+            entSnapshot.componentMask |= 1u << componentIdx;
+            component.quantize(component, world, ent, entSnapshot.values.data() + component.valueOffset);
+        }
+        if (!entSnapshot.componentMask) return;
+
+        snapshot.entities.emplace(ent, entSnapshot);
+        byDistance.emplace_back(distanceSqr, ent);
+    });
+
+    std::sort(byDistance.begin(), byDistance.end(), [](auto const& a, auto const& b) { return a.first < b.first; });
+    priority.clear();
+    priority.reserve(byDistance.size());
+    for (auto [distanceSqr, ent]: byDistance) priority.push_back(ent);
+    return snapshot;
+}
+
+void writeEntityDelta(ByteWriter& writer, entt::entity ent, EntitySnapshot const* base, EntitySnapshot const& current) {
+    static EntitySnapshot const empty{};
+    if (!base) base = &empty;
+
+    auto const& components = replicatedComponents();
+    writer.writeVarUint(entt::to_integral(ent));
+    writer.writeVarUint(current.componentMask);
+    for (size_t componentIdx = 0; componentIdx < components.size(); ++componentIdx) {
+        if (!(current.componentMask & 1u << componentIdx)) continue;
+
+        ReplicatedComponent const& component = components[componentIdx];
+        // A component the baseline did not have is sent relative to zero, which is what the client has for it
+        bool isNew = !(base->componentMask & 1u << componentIdx);
+        uint32_t changedMask = 0;
+        for (size_t fieldIdx = 0; fieldIdx < component.fields.size(); ++fieldIdx) {
+            size_t valueIdx = component.valueOffset + fieldIdx;
+            int32_t baseValue = isNew ? 0 : base->values[valueIdx];
+            if (current.values[valueIdx] != baseValue) changedMask |= 1u << fieldIdx;
+        }
+        writer.writeVarUint(changedMask);
+        for (size_t fieldIdx = 0; fieldIdx < component.fields.size(); ++fieldIdx) {
+            if (!(changedMask & 1u << fieldIdx)) continue;
+
+            size_t valueIdx = component.valueOffset + fieldIdx;
+            int32_t baseValue = isNew ? 0 : base->values[valueIdx];
+            writer.writeVarInt(static_cast<int64_t>(current.values[valueIdx]) - baseValue);
+        }
+    }
+}
+
+void writeSnapshotDelta(ByteWriter& writer, Snapshot const& baseline, Snapshot& current,
+                        std::span<entt::entity const> priority, size_t maxBytes) {
+    std::vector<entt::entity> removed;
+    for (auto const& [ent, entSnapshot]: baseline.entities) {
+        if (!current.entities.contains(ent)) removed.push_back(ent);
+    }
+    // Removals are cheap but unbounded, past a quarter of the budget the rest wait for the next snapshot
+    size_t removedCountOffset = writer.size();
+    writer.write(uint16_t{0});
+    size_t removalLimit = writer.size() + maxBytes / 4;
+    uint16_t removedCount = 0;
+    for (entt::entity ent: removed) {
+        if (writer.size() < removalLimit && removedCount < std::numeric_limits<uint16_t>::max()) {
+            writer.writeVarUint(entt::to_integral(ent));
+            removedCount++;
+        } else {
+            current.entities.emplace(ent, baseline.entities.at(ent));
+        }
+    }
+    writer.patch(removedCountOffset, removedCount);
+
+    size_t countOffset = writer.size();
+    writer.write(uint16_t{0});
+    uint16_t writtenCount = 0;
+    bool isFull = false;
+    for (entt::entity ent: priority) {
+        auto currentIt = current.entities.find(ent);
+        if (currentIt == current.entities.end()) continue;
+
+        auto baseIt = baseline.entities.find(ent);
+        EntitySnapshot const* base = baseIt == baseline.entities.end() ? nullptr : &baseIt->second;
+        if (base && *base == currentIt->second) continue;
+
+        size_t before = writer.size();
+        if (!isFull) {
+            writeEntityDelta(writer, ent, base, currentIt->second);
+            isFull = writer.size() > maxBytes || writtenCount == std::numeric_limits<uint16_t>::max();
+        }
+        if (isFull) {
+            // Did not make it, the client keeps what it had so we have to as well
+            writer.truncate(before);
+            if (base) {
+                currentIt->second = *base;
+            } else {
+                current.entities.erase(currentIt);
+            }
+            continue;
+        }
+        writtenCount++;
+    }
+    writer.patch(countOffset, writtenCount);
+}
+
+Snapshot readSnapshotDelta(ByteReader& reader, Snapshot const& baseline, tick_t tick) {
+    auto const& components = replicatedComponents();
+    Snapshot snapshot{tick, baseline.entities};
+
+    auto removedCount = reader.read<uint16_t>();
+    for (uint16_t removedIdx = 0; removedIdx < removedCount; ++removedIdx) {
+        snapshot.entities.erase(static_cast<entt::entity>(reader.readVarUint()));
+    }
+
+    auto entityCount = reader.read<uint16_t>();
+    for (uint16_t entityIdx = 0; entityIdx < entityCount; ++entityIdx) {
+        auto ent = static_cast<entt::entity>(reader.readVarUint());
+        auto componentMask = static_cast<uint32_t>(reader.readVarUint());
+        EntitySnapshot& entSnapshot = snapshot.entities[ent];
+        EntitySnapshot base = entSnapshot;
+        entSnapshot = {componentMask, {}};
+        for (size_t componentIdx = 0; componentIdx < components.size(); ++componentIdx) {
+            if (!(componentMask & 1u << componentIdx)) continue;
+
+            ReplicatedComponent const& component = components[componentIdx];
+            bool isNew = !(base.componentMask & 1u << componentIdx);
+            auto changedMask = static_cast<uint32_t>(reader.readVarUint());
+            for (size_t fieldIdx = 0; fieldIdx < component.fields.size(); ++fieldIdx) {
+                size_t valueIdx = component.valueOffset + fieldIdx;
+                int64_t value = isNew ? 0 : base.values[valueIdx];
+                if (changedMask & 1u << fieldIdx) value += reader.readVarInt();
+                entSnapshot.values[valueIdx] = static_cast<int32_t>(value);
+            }
+        }
+    }
+    if (!reader.isDone()) throw std::runtime_error("Snapshot has trailing data");
+
+    return snapshot;
+}
+
+void writeHeader(ByteWriter& writer, PacketType type) {
+    writer.clear();
+    writer.write(static_cast<uint8_t>(type));
+    writer.write(ProtocolId);
+}
+
+/** @return The packet type, or nothing if this is not a packet of ours */
+std::optional<PacketType> readHeader(ByteReader& reader) {
+    auto type = reader.read<uint8_t>();
+    if (reader.read<uint16_t>() != ProtocolId || type > static_cast<uint8_t>(PacketType::Ack)) return {};
+
+    return static_cast<PacketType>(type);
+}
+
+void ReplicationServerPlugin::build(App& app) {
+    mSocket.emplace(mPort);
+    app.globalCtx.emplace<ReplicationStats>();
+    std::cout << "[Replication]" << " Listening on port " << mSocket->port() << std::endl;
+}
+
+void ReplicationServerPlugin::access(SystemAccess& access) {
+    // Spawns and removes the players of clients that come and go
+    access.read<SimulationClock, ModelHandle>()
+            .write<LogicWorldAccess, ReplicationStats, Player, Position, Orientation, LinearVelocity, Look, Input, Timestamp, GroundedPlayerMove, MoveStats>();
+}
+
+void ReplicationServerPlugin::execute(App& app) {
+    receive(app);
+    send(app);
+}
+
+void ReplicationServerPlugin::receive(App& app) {
+    auto& stats = app.globalCtx.at<ReplicationStats>();
+    clock_point_t now = steady_clock_t::now();
+    std::array<std::byte, MaxPacketBytes> buffer{};
+    NetAddress from;
+    while (std::optional<size_t> size = mSocket->receiveFrom(buffer, from)) {
+        stats.bytesReceived += *size;
+        stats.packetsReceived++;
+        try {
+            ByteReader reader{std::span{buffer}.first(*size)};
+            std::optional<PacketType> type = readHeader(reader);
+            if (!type) continue;
+
+            auto clientIt = std::find_if(mClients.begin(), mClients.end(), [&](ClientConnection const& client) { return client.address == from; });
+            if (*type == PacketType::Hello) {
+                if (clientIt != mClients.end()) {
+                    clientIt->lastHeard = now;
+                } else if (*size >= MinHelloBytes && mClients.size() < mMaxClients) {
+                    challenge(from, now);
+                }
+            } else if (*type == PacketType::ChallengeResponse && clientIt == mClients.end()) {
+                auto possessionId = reader.read<possesion_id_t>();
+                auto nonce = reader.read<uint64_t>();
+                auto challengeIt = std::find_if(mChallenges.begin(), mChallenges.end(), [&](PendingChallenge const& pending) {
+                    return pending.address == from && pending.nonce == nonce;
+                });
+                if (challengeIt == mChallenges.end()) continue;
+
+                mChallenges.erase(challengeIt);
+                bool isTaken = std::any_of(mClients.begin(), mClients.end(), [possessionId](ClientConnection const& client) { return client.possessionId == possessionId; });
+                if (isTaken || mClients.size() >= mMaxClients) continue;
+
+                ClientConnection& client = mClients.emplace_back(ClientConnection{from, possessionId, now});
+                bool hasPlayer = false;
+                for (auto [ent, player]: app.logicWorld.view<const Player>().each()) {
+                    if (player.possessionId == possessionId) hasPlayer = true;
+                }
+                if (!hasPlayer) client.player = spawnPlayer(app.logicWorld, possessionId);
+                std::cout << "[Replication]" << " Client connected from port " << from.port << std::endl;
+            } else if (*type == PacketType::Ack && clientIt != mClients.end()) {
+                auto tick = reader.read<tick_t>();
+                clientIt->lastHeard = now;
+                auto& inFlight = clientIt->inFlight;
+                auto ackedIt = std::find_if(inFlight.begin(), inFlight.end(), [tick](Snapshot const& snapshot) { return snapshot.tick == tick; });
+                if (ackedIt == inFlight.end()) continue;
+
+                clientIt->baseline = std::move(*ackedIt);
+                inFlight.erase(inFlight.begin(), ackedIt + 1);
+            }
+        } catch (std::runtime_error const&) {
+            // Truncated or garbage datagram, there is no telling who sent it so just drop it
+        }
+    }
+
+    std::erase_if(mClients, [&](ClientConnection const& client) {
+        if (now - client.lastHeard <= ClientTimeout) return false;
+
+        if (app.logicWorld.valid(client.player)) app.logicWorld.destroy(client.player);
+        return true;
+    });
+    std::erase_if(mChallenges, [now](PendingChallenge const& pending) { return now - pending.sentAt > ChallengeTimeout; });
+    stats.clientCount = mClients.size();
+}
+
+void ReplicationServerPlugin::challenge(NetAddress const& from, clock_point_t now) {
+    auto pendingIt = std::find_if(mChallenges.begin(), mChallenges.end(), [&](PendingChallenge const& pending) { return pending.address == from; });
+    if (pendingIt == mChallenges.end()) {
+        // Drawn from the system's entropy so seeing the nonces sent to our own address tells nothing about anyone else's
+        PendingChallenge pending{from, static_cast<uint64_t>(mRandom()) << 32 | mRandom(), now};
+        if (mChallenges.size() < mMaxClients * 2) {
+            pendingIt = mChallenges.insert(mChallenges.end(), pending);
+        } else {
+            pendingIt = std::min_element(mChallenges.begin(), mChallenges.end(), [](PendingChallenge const& a, PendingChallenge const& b) { return a.sentAt < b.sentAt; });
+            *pendingIt = pending;
+        }
+    }
+
+    writeHeader(mWriter, PacketType::Challenge);
+    mWriter.write(pendingIt->nonce);
+    mSocket->sendTo(from, mWriter.bytes());
+}
+
+void ReplicationServerPlugin::send(App& app) {
+    tick_t tick = app.globalCtx.at<SimulationClock>().tick;
+    // Nothing has changed since the last tick was sent
+    if (mLastSentTick == tick) return;
+
+    mLastSentTick = tick;
+    auto& stats = app.globalCtx.at<ReplicationStats>();
+    static Snapshot const empty{};
+    std::vector<entt::entity> priority;
+    for (ClientConnection& client: mClients) {
+        clock_point_t start = steady_clock_t::now();
+        vec3 center = edyn::vector3_zero;
+        for (auto [ent, player, pos]: app.logicWorld.view<const Player, const Position>().each()) {
+            if (player.possessionId == client.possessionId) center = pos;
+        }
+        Snapshot snapshot = captureSnapshot(app.logicWorld, center, mInterestRadius, priority);
+        snapshot.tick = tick;
+
+        writeHeader(mWriter, PacketType::Snapshot);
+        mWriter.write(tick);
+        mWriter.write(client.baseline ? client.baseline->tick : NoBaseline);
+        writeSnapshotDelta(mWriter, client.baseline ? *client.baseline : empty, snapshot, priority, mMaxPacketBytes);
+        stats.encodeTime = steady_clock_t::now() - start;
+
+        mSocket->sendTo(client.address, mWriter.bytes());
+        stats.bytesSent += mWriter.size();
+        stats.packetsSent++;
+
+        client.inFlight.push_back(std::move(snapshot));
+        if (client.inFlight.size() > MaxInFlightSnapshots) client.inFlight.pop_front();
+    }
+}
+
+void ReplicationClientPlugin::build(App& app) {
+    mSocket.emplace();
+    app.globalCtx.emplace<ReplicationStats>();
+}
+
+void ReplicationClientPlugin::access(SystemAccess& access) {
+    access.write<LogicWorldAccess, ReplicationStats, Position, Orientation, LinearVelocity, Look, ModelHandle, Material>();
+}
+
+void ReplicationClientPlugin::execute(App& app) {
+    auto& stats = app.globalCtx.at<ReplicationStats>();
+    clock_point_t now = steady_clock_t::now();
+    if (mReceived.empty() && now - mLastHello > HelloInterval) {
+        writeHeader(mWriter, PacketType::Hello);
+        while (mWriter.size() < MinHelloBytes) mWriter.write(uint8_t{0});
+        mSocket->sendTo(mServer, mWriter.bytes());
+        mLastHello = now;
+    }
+
+    std::array<std::byte, MaxPacketBytes> buffer{};
+    NetAddress from;
+    Snapshot const* newest = nullptr;
+    while (std::optional<size_t> size = mSocket->receiveFrom(buffer, from)) {
+        if (from != mServer) continue;
+
+        stats.bytesReceived += *size;
+        stats.packetsReceived++;
+        try {
+            ByteReader reader{std::span{buffer}.first(*size)};
+            std::optional<PacketType> type = readHeader(reader);
+            if (type == PacketType::Challenge) {
+                auto nonce = reader.read<uint64_t>();
+                writeHeader(mWriter, PacketType::ChallengeResponse);
+                mWriter.write(mPossessionId);
+                mWriter.write(nonce);
+                mSocket->sendTo(mServer, mWriter.bytes());
+                continue;
+            }
+            if (type != PacketType::Snapshot) continue;
+
+            auto tick = reader.read<tick_t>();
+            auto baselineTick = reader.read<tick_t>();
+            // Out of order, we already have something newer
+            if (!mReceived.empty() && tick <= mReceived.back().tick) continue;
+
+            static Snapshot const empty{};
+            Snapshot const* baseline = &empty;
+            if (baselineTick != NoBaseline) {
+                auto baselineIt = std::find_if(mReceived.begin(), mReceived.end(), [baselineTick](Snapshot const& snapshot) { return snapshot.tick == baselineTick; });
+                // Already dropped, the server moves on to a newer baseline once our later acks arrive
+                if (baselineIt == mReceived.end()) continue;
+
+                baseline = &*baselineIt;
+            }
+            clock_point_t start = steady_clock_t::now();
+            Snapshot snapshot = readSnapshotDelta(reader, *baseline, tick);
+            stats.decodeTime = steady_clock_t::now() - start;
+            mReceived.push_back(std::move(snapshot));
+            if (mReceived.size() > MaxReceivedSnapshots) mReceived.pop_front();
+            newest = &mReceived.back();
+
+            writeHeader(mWriter, PacketType::Ack);
+            mWriter.write(tick);
+            mSocket->sendTo(mServer, mWriter.bytes());
+            stats.bytesSent += mWriter.size();
+            stats.packetsSent++;
+        } catch (std::runtime_error const&) {
+            // Malformed snapshot, the next one is delta encoded against something we acknowledged so nothing is lost
+        }
+    }
+
+    if (newest) apply(app, *newest);
+}
+
+void ReplicationClientPlugin::apply(App& app, Snapshot const& snapshot) {
+    auto const& components = replicatedComponents();
+    World& world = app.logicWorld;
+    for (auto const& [serverEnt, entSnapshot]: snapshot.entities) {
+        auto [localIt, isNew] = mServerToLocal.try_emplace(serverEnt);
+        if (isNew) localIt->second = world.create();
+        entt::entity localEnt = localIt->second;
+
+        auto appliedIt = mApplied.entities.find(serverEnt);
+        uint32_t appliedMask = appliedIt == mApplied.entities.end() ? 0 : appliedIt->second.componentMask;
+        if (appliedIt != mApplied.entities.end() && appliedIt->second == entSnapshot) continue;
+
+        for (size_t componentIdx = 0; componentIdx < components.size(); ++componentIdx) {
+            ReplicatedComponent const& component = components[componentIdx];
+            if (entSnapshot.componentMask & 1u << componentIdx) {
+                component.apply(component, world, localEnt, entSnapshot.values.data() + component.valueOffset);
+            } else if (appliedMask & 1u << componentIdx) {
+                component.remove(world, localEnt);
+            }
+        }
+        if (world.all_of<ModelHandle>(localEnt) && !world.all_of<Material>(localEnt)) {
+            world.emplace<Material>(localEnt, MirroredMaterial);
+        }
+    }
+    for (auto const& [serverEnt, entSnapshot]: mApplied.entities) {
+        if (snapshot.entities.contains(serverEnt)) continue;
+
+        auto localIt = mServerToLocal.find(serverEnt);
+        if (localIt == mServerToLocal.end()) continue;
+
+        if (world.valid(localIt->second)) world.destroy(localIt->second);
+        mServerToLocal.erase(localIt);
+    }
+    mApplied = snapshot;
+}
@@ -0,0 +1,168 @@
+#pragma once
+
+#include "game_pch.hpp"
+
+#include <deque>
+#include <random>
+
+#include "app.hpp"
+#include "state.hpp"
+#include "plugin.hpp"
+#include "socket.hpp"
+#include "byte_stream.hpp"
+
+constexpr uint16_t DefaultServerPort = 27015;
+// Stays under the usual internet MTU so snapshots never get fragmented
+constexpr size_t MaxPacketBytes = 1200;
+// Quantized values per entity across all replicated components
+constexpr size_t MaxReplicatedValues = 32;
+constexpr size_t DefaultMaxClients = 32;
+
+// A client says hello, echoes back the nonce the server challenges it with, and only then gets snapshots
+enum class PacketType : uint8_t {
+    Hello, Challenge, ChallengeResponse, Snapshot, Ack
+};
+
+/** @brief A component sent to clients, every reflected field of it is quantized to an integer */
+struct ReplicatedComponent {
+    std::vector<entt::meta_data> fields;
+    // Size of a quantization step for floating point fields, integral fields are sent as they are
+    double step;
+    // Where this component's fields start in an entity's values
+    size_t valueOffset;
+    bool (* has)(World const& world, entt::entity ent);
+    void (* quantize)(ReplicatedComponent const& replicated, World const& world, entt::entity ent, int32_t* values);
+    void (* apply)(ReplicatedComponent const& replicated, World& world, entt::entity ent, int32_t const* values);
+    void (* remove)(World& world, entt::entity ent);
+};
+
+/** @brief What is replicated, a component's index here is its bit in component masks. Reflection must be registered first. */
+std::vector<ReplicatedComponent> const& replicatedComponents();
+
+struct EntitySnapshot {
+    uint32_t componentMask{};
+    // Components an entity does not have are left zeroed, which is also what a new component is sent relative to
+    std::array<int32_t, MaxReplicatedValues> values{};
+
+    bool operator==(EntitySnapshot const&) const = default;
+};
+
+struct Snapshot {
+    tick_t tick{};
+    std::unordered_map<entt::entity, EntitySnapshot> entities;
+};
+
+/**
+ * @brief Quantizes every replicated entity within the radius of the center.
+ * @param priority  Filled with the captured entities nearest first, which is the order they are sent in
+ */
+Snapshot captureSnapshot(World const& world, vec3 const& center, scalar radius, std::vector<entt::entity>& priority);
+
+/**
+ * @brief Writes what changed from the baseline the client already has to the current snapshot.
+ *        Entities that do not fit in the budget are put back to their baseline in current,
+ *        so it always matches what the client decodes and can be used as a baseline itself.
+ */
+void writeSnapshotDelta(ByteWriter& writer, Snapshot const& baseline, Snapshot& current,
+                        std::span<entt::entity const> priority, size_t maxBytes);
+
+Snapshot readSnapshotDelta(ByteReader& reader, Snapshot const& baseline, tick_t tick);
+
+struct ReplicationStats {
+    size_t bytesSent{}, bytesReceived{};
+    size_t packetsSent{}, packetsReceived{};
+    size_t clientCount{};
+    clock_delta_t encodeTime{}, decodeTime{};
+};
+
+/**
+ * @brief Sends every client a snapshot of the logic world each tick over UDP.
+ *
+ * Snapshots are delta encoded against the last one the client acknowledged, so lost packets need no resending.
+ * Each client only gets entities within the interest radius of its player, nearest first until the packet is full.
+ * Each new client gets a player spawned for its possession id, which is removed again when the client times out.
+ * An address only becomes a client once it has echoed a challenge nonce, so spoofed hellos never get snapshots sent to them.
+ */
+class ReplicationServerPlugin : public Plugin {
+public:
+    explicit ReplicationServerPlugin(uint16_t port = DefaultServerPort, scalar interestRadius = 64.0, size_t maxPacketBytes = MaxPacketBytes,
+                                     size_t maxClients = DefaultMaxClients)
+            : mPort(port), mInterestRadius(interestRadius), mMaxPacketBytes(maxPacketBytes), mMaxClients(maxClients) {}
+
+    void build(App& app) override;
+
+    void access(SystemAccess& access) override;
+
+    void execute(App& app) override;
+
+    [[nodiscard]] uint16_t port() const {
+        return mSocket ? mSocket->port() : mPort;
+    }
+
+private:
+    struct ClientConnection {
+        NetAddress address;
+        possesion_id_t possessionId;
+        clock_point_t lastHeard;
+        std::optional<Snapshot> baseline;
+        // Sent but not acknowledged yet, oldest first
+        std::deque<Snapshot> inFlight;
+        // Only set when we spawned it, a player that was already there for this possession id is left alone
+        entt::entity player{entt::null};
+    };
+
+    struct PendingChallenge {
+        NetAddress address;
+        uint64_t nonce;
+        clock_point_t sentAt;
+    };
+
+    uint16_t mPort;
+    scalar mInterestRadius;
+    size_t mMaxPacketBytes;
+    size_t mMaxClients;
+    std::optional<UdpSocket> mSocket;
+    std::vector<ClientConnection> mClients;
+    // Bounded, so a flood of hellos from spoofed addresses only ever evicts other pending challenges
+    std::vector<PendingChallenge> mChallenges;
+    std::random_device mRandom;
+    std::optional<tick_t> mLastSentTick;
+    ByteWriter mWriter;
+
+    void receive(App& app);
+
+    void challenge(NetAddress const& from, clock_point_t now);
+
+    void send(App& app);
+};
+
+/**
+ * @brief Mirrors the server's snapshots into the logic world, acknowledging each one so the server can delta against it.
+ *
+ * Only the replication benchmark uses this for now. The game client does not connect to servers yet,
+ * since nothing sends player input to the server and mirrored entities would sit alongside the client's own level.
+ */
+class ReplicationClientPlugin : public Plugin {
+public:
+    ReplicationClientPlugin(NetAddress server, possesion_id_t possessionId)
+            : mServer(server), mPossessionId(possessionId) {}
+
+    void build(App& app) override;
+
+    void access(SystemAccess& access) override;
+
+    void execute(App& app) override;
+
+private:
+    NetAddress mServer;
+    possesion_id_t mPossessionId;
+    std::optional<UdpSocket> mSocket;
+    clock_point_t mLastHello;
+    // Recently decoded snapshots, newest last, the server deltas against whichever of these it last heard an ack for
+    std::deque<Snapshot> mReceived;
+    Snapshot mApplied;
+    std::unordered_map<entt::entity, entt::entity> mServerToLocal;
+    ByteWriter mWriter;
+
+    void apply(App& app, Snapshot const& snapshot);
+};
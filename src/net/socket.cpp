@@ -0,0 +1,152 @@
+#include "socket.hpp"
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#endif
+
+#ifdef _WIN32
+using socket_t = SOCKET;
+using socklen_t = int;
+constexpr socket_t InvalidSocket = INVALID_SOCKET;
+
+bool isWouldBlock() {
+    int error = WSAGetLastError();
+    // Windows reports an earlier send to a closed port on the next receive, which is no reason to stop reading
+    return error == WSAEWOULDBLOCK || error == WSAECONNRESET;
+}
+
+void closeSocket(socket_t handle) {
+    closesocket(handle);
+}
+
+void initSockets() {
+    [[maybe_unused]] static bool isInitialized = [] {
+        WSADATA data;
+        if (WSAStartup(MAKEWORD(2, 2), &data) != 0) throw std::runtime_error("Failed to initialize Winsock");
+        return true;
+    }();
+}
+#else
+using socket_t = int;
+constexpr socket_t InvalidSocket = -1;
+
+bool isWouldBlock() {
+    return errno == EAGAIN || errno == EWOULDBLOCK || errno == ECONNREFUSED;
+}
+
+void closeSocket(socket_t handle) {
+    close(handle);
+}
+
+void initSockets() {}
+#endif
+
+sockaddr_in toSockAddr(NetAddress const& address) {
+    sockaddr_in sockAddr{};
+    sockAddr.sin_family = AF_INET;
+    sockAddr.sin_addr.s_addr = htonl(address.host);
+    sockAddr.sin_port = htons(address.port);
+    return sockAddr;
+}
+
+std::optional<NetAddress> NetAddress::parse(std::string_view text) {
+    size_t colon = text.rfind(':');
+    if (colon == std::string_view::npos) return {};
+
+    uint32_t host = 0;
+    size_t octetStart = 0;
+    for (int octetIdx = 0; octetIdx < 4; ++octetIdx) {
+        size_t octetEnd = octetIdx == 3 ? colon : text.find('.', octetStart);
+        if (octetEnd == std::string_view::npos || octetEnd > colon || octetEnd == octetStart) return {};
+
+        uint32_t octet = 0;
+        for (char c: text.substr(octetStart, octetEnd - octetStart)) {
+            if (c < '0' || c > '9') return {};
+            octet = octet * 10 + (c - '0');
+        }
+        if (octet > 255) return {};
+
+        host = host << 8 | octet;
+        octetStart = octetEnd + 1;
+    }
+
+    uint32_t port = 0;
+    std::string_view portText = text.substr(colon + 1);
+    if (portText.empty()) return {};
+    for (char c: portText) {
+        if (c < '0' || c > '9') return {};
+        port = port * 10 + (c - '0');
+        if (port > std::numeric_limits<uint16_t>::max()) return {};
+    }
+    return NetAddress{host, static_cast<uint16_t>(port)};
+}
+
+UdpSocket::UdpSocket(uint16_t port) {
+    initSockets();
+    socket_t handle = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (handle == InvalidSocket) throw std::runtime_error("Failed to create socket");
+
+    mHandle = static_cast<intptr_t>(handle);
+    sockaddr_in sockAddr = toSockAddr({INADDR_ANY, port});
+    if (bind(handle, reinterpret_cast<sockaddr*>(&sockAddr), sizeof(sockAddr)) != 0) {
+        closeSocket(handle);
+        throw std::runtime_error("Failed to bind socket to port " + std::to_string(port));
+    }
+#ifdef _WIN32
+    u_long isNonBlocking = 1;
+    bool isSet = ioctlsocket(handle, FIONBIO, &isNonBlocking) == 0;
+#else
+    bool isSet = fcntl(handle, F_SETFL, fcntl(handle, F_GETFL, 0) | O_NONBLOCK) == 0;
+#endif
+    if (!isSet) {
+        closeSocket(handle);
+        throw std::runtime_error("Failed to make socket non-blocking");
+    }
+}
+
+UdpSocket::~UdpSocket() {
+    closeSocket(static_cast<socket_t>(mHandle));
+}
+
+void UdpSocket::sendTo(NetAddress const& address, std::span<std::byte const> data) {
+    sockaddr_in sockAddr = toSockAddr(address);
+    auto sent = sendto(static_cast<socket_t>(mHandle), reinterpret_cast<char const*>(data.data()), static_cast<int>(data.size()), 0,
+                       reinterpret_cast<sockaddr*>(&sockAddr), sizeof(sockAddr));
+    // Datagrams may be dropped anywhere along the way anyway, so a full send buffer is not worth failing over
+    if (sent < 0 && !isWouldBlock()) throw std::runtime_error("Failed to send datagram");
+}
+
+std::optional<size_t> UdpSocket::receiveFrom(std::span<std::byte> buffer, NetAddress& from) {
+    sockaddr_in sockAddr{};
+    socklen_t sockAddrSize = sizeof(sockAddr);
+    while (true) {
+        auto received = recvfrom(static_cast<socket_t>(mHandle), reinterpret_cast<char*>(buffer.data()), static_cast<int>(buffer.size()), 0,
+                                 reinterpret_cast<sockaddr*>(&sockAddr), &sockAddrSize);
+        if (received >= 0) {
+            from = {ntohl(sockAddr.sin_addr.s_addr), ntohs(sockAddr.sin_port)};
+            return static_cast<size_t>(received);
+        }
+        if (!isWouldBlock()) throw std::runtime_error("Failed to receive datagram");
+#ifdef _WIN32
+        if (WSAGetLastError() == WSAECONNRESET) continue;
+#else
+        if (errno == ECONNREFUSED) continue;
+#endif
+        return {};
+    }
+}
+
+uint16_t UdpSocket::port() const {
+    sockaddr_in sockAddr{};
+    socklen_t sockAddrSize = sizeof(sockAddr);
+    getsockname(static_cast<socket_t>(mHandle), reinterpret_cast<sockaddr*>(&sockAddr), &sockAddrSize);
+    return ntohs(sockAddr.sin_port);
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "game_pch.hpp"
+
+#include <span>
+
+/** @brief IPv4 address and port, both in host byte order */
+struct NetAddress {
+    uint32_t host{};
+    uint16_t port{};
+
+    auto operator<=>(NetAddress const&) const = default;
+
+    static NetAddress loopback(uint16_t port) {
+        return {0x7F000001, port};
+    }
+
+    /** @brief Parses dotted decimal with a port, such as 127.0.0.1:27015 */
+    static std::optional<NetAddress> parse(std::string_view text);
+};
+
+/**
+ * @brief Non-blocking UDP socket bound to a local port.
+ *
+ * Errors that mean nothing is there to read are reported as an empty optional, anything else throws.
+ */
+class UdpSocket {
+private:
+    intptr_t mHandle;
+
+public:
+    /** @param port Local port to bind, zero lets the system pick one */
+    explicit UdpSocket(uint16_t port = 0);
+
+    UdpSocket(UdpSocket const&) = delete;
+
+    UdpSocket& operator=(UdpSocket const&) = delete;
+
+    ~UdpSocket();
+
+    void sendTo(NetAddress const& address, std::span<std::byte const> data);
+
+    /** @return Size of the datagram read into the buffer, or nothing if none is waiting */
+    std::optional<size_t> receiveFrom(std::span<std::byte> buffer, NetAddress& from);
+
+    [[nodiscard]] uint16_t port() const;
+};
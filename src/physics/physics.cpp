@@ -1,12 +1,17 @@
 #include "physics.hpp"
 
 #include "app.hpp"
+#include "state.hpp"
 
 void PhysicsPlugin::build(App& app) {
     edyn::init();
     std::cout << "[Edyn]" << " 1.1.0 initialized" << std::endl;
     edyn::attach(app.logicWorld);
     std::cout << "[Edyn]" << " Attached" << std::endl;
+    // Stepped explicitly once per simulation tick instead of following real time on its own
+    auto& clock = app.globalCtx.at<SimulationClock>();
+    edyn::set_fixed_dt(app.logicWorld, sec_t(clock.tickDelta).count());
+    edyn::set_paused(app.logicWorld, true);
 
     auto floorDef = edyn::rigidbody_def();
     floorDef.kind = edyn::rigidbody_kind::rb_static;
@@ -17,7 +22,13 @@ void PhysicsPlugin::build(App& app) {
     edyn::make_rigidbody(app.logicWorld, floorDef);
 }
 
+void PhysicsPlugin::access(SystemAccess& access) {
+    // Edyn creates and destroys its own entities while stepping
+    access.write<LogicWorldAccess, Position, Orientation, LinearVelocity>();
+}
+
 void PhysicsPlugin::execute(App& app) {
+    edyn::step_simulation(app.logicWorld);
     edyn::update(app.logicWorld);
 }
 
@@ -4,6 +4,8 @@
 
 class PhysicsPlugin : public Plugin {
 public:
+    void access(SystemAccess& access) override;
+
     void build(App& app) override;
 
     void execute(App& app) override;
@@ -0,0 +1,26 @@
+#include "fake_server.hpp"
+
+#include "app.hpp"
+
+void FakeServerPlugin::build(App& app) {
+    GAME_ASSERT(mLatencyTicks < RollbackTicks);
+}
+
+void FakeServerPlugin::access(SystemAccess& access) {
+    access.read<SimulationClock, PlayerHistory>().write<ServerCorrections>();
+}
+
+void FakeServerPlugin::execute(App& app) {
+    tick_t tick = app.globalCtx.at<SimulationClock>().tick;
+    if (tick < mLatencyTicks) return;
+
+    // Read back when sent rather than when recorded, so states replayed since are what gets echoed
+    tick_t sentTick = tick - mLatencyTicks;
+    auto& corrections = app.globalCtx.at<ServerCorrections>();
+    for (PlayerSnapshot correction: app.playerHistory.at(sentTick)) {
+        if (mDesyncInterval && sentTick % mDesyncInterval == 0) {
+            correction.position += mDesyncOffset;
+        }
+        corrections.pending.push_back(correction);
+    }
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "game_pch.hpp"
+
+#include "state.hpp"
+#include "plugin.hpp"
+
+/**
+ * @brief Stands in for a remote server in the same process so prediction can be exercised without networking.
+ *
+ * Sends the local player's own recorded states back as corrections after a delay, so a correct prediction is never rewound.
+ * Every desync interval ticks the state sent back is moved by an offset instead, as if the server had seen it differently.
+ */
+class FakeServerPlugin : public Plugin {
+public:
+    /**
+     * @param latencyTicks      How many ticks old a correction is when it arrives
+     * @param desyncInterval    How often the server disagrees, zero for never
+     */
+    explicit FakeServerPlugin(tick_t latencyTicks = 8, tick_t desyncInterval = 0, vec3 desyncOffset = {0.0, 0.0, 0.0})
+            : mLatencyTicks(latencyTicks), mDesyncInterval(desyncInterval), mDesyncOffset(desyncOffset) {}
+
+    void build(App& app) override;
+
+    void access(SystemAccess& access) override;
+
+    void execute(App& app) override;
+
+private:
+    tick_t mLatencyTicks, mDesyncInterval;
+    vec3 mDesyncOffset;
+};
@@ -25,12 +25,119 @@ void accelerate(scalar accel, vec3 wishDir, scalar wishSpeed, vec3& linVel, scal
     linVel.y += wishDir.y;
 }
 
+void PlayerControllerPlugin::access(SystemAccess& access) {
+    access.read<LogicWorldAccess, Input, Timestamp, Position, FlyPlayerMove>()
+            .write<Look, GroundedPlayerMove, MoveStats, LinearVelocity>();
+}
+
+void applyLook(Input const& input, Look& look) {
+    look += vec3{-input.cursorDelta.y, 0.0, input.cursorDelta.x};
+    look.x = std::clamp(look.x, -XLookCap, XLookCap);
+    look.z = std::fmod(look.z + Tau / 2.0, Tau) - Tau / 2.0;
+    look.y = input.lean * edyn::to_radians(15.0);
+}
+
+void applyGroundedMove(World& world, entt::entity ent, Input const& input, Look const& look, Position const& pos,
+                       GroundedPlayerMove& move, LinearVelocity& linVel, scalar dt, MoveStats* stats) {
+    vec3 initVel = move.linVel;
+    vec3 endVel = initVel;
+    scalar lateralSpeed = length(to_vector2_xy(initVel));
+
+    edyn::raycast_result result = edyn::raycast(
+            world,
+            pos,
+            pos - vec3{0.0, 0.0, 1.0625},
+            [myEnt=ent](entt::entity hitEnt) { return hitEnt == myEnt; } // prevent self collisions
+    );
+    vec3 wishDir = edyn::rotate(fromEuler(look), {input.move.x * move.sideSpeed, input.move.y * move.fwdSpeed, 0.0});
+    scalar wishSpeed = length(wishDir);
+    if (wishSpeed > SCALAR_EPSILON)
+        wishDir /= wishSpeed;
+
+    bool isGrounded = result.entity != entt::null;
+
+    wishSpeed = std::min(wishSpeed, move.runSpeed);
+
+    if (stats) {
+        stats->wishDir = wishDir;
+        stats->wishSpeed = wishSpeed;
+        stats->lateralSpeed = lateralSpeed;
+    }
+
+    if (isGrounded) {
+        if (move.groundTick >= 1) {
+            if (lateralSpeed > move.frictionCutoff) {
+                friction(move.friction, move.stopSpeed, lateralSpeed, endVel, dt);
+            } else {
+                endVel.x = endVel.y = 0.0;
+            }
+            endVel.z = -0.0625;
+        }
+        accelerate(move.accel, wishDir, wishSpeed, endVel, dt);
+        if (input.jump.current) {
+            initVel.z = move.jumpSpeed;
+            endVel.z = initVel.z - move.gravity * dt;
+        }
+        move.groundTick = saturating_increment(move.groundTick);
+
+    } else {
+        move.groundTick = 0;
+        wishSpeed = std::min(wishSpeed, move.airSpeedCap);
+        accelerate(move.airAccel, wishDir, wishSpeed, endVel, dt);
+        endVel.z -= move.gravity * dt;
+        scalar airSpeed = length(to_vector2_xy(endVel));
+        if (airSpeed > move.maxAirSpeed) {
+            scalar ratio = move.maxAirSpeed / airSpeed;
+            endVel.x *= ratio;
+            endVel.y *= ratio;
+        }
+    }
+
+    move.linVel = endVel;
+    linVel = (initVel + endVel) * 0.5;
+}
+
+entt::entity spawnPlayer(World& world, possesion_id_t possessionId) {
+    entt::entity ent = world.create();
+    world.emplace<Player>(ent, possessionId);
+    world.emplace<Look>(ent);
+    world.emplace<Input>(ent);
+    world.emplace<Timestamp>(ent);
+    world.emplace<GroundedPlayerMove>(ent, GroundedPlayerMove{
+            .gravity = 30.0,
+            .walkSpeed = 5.0,
+            .runSpeed = 15.0,
+            .fwdSpeed = 20.0,
+            .sideSpeed = 20.0,
+            .airSpeedCap = 2.0,
+            .airAccel = 20.0,
+            .maxAirSpeed = 17.0,
+            .accel = 15.0,
+            .friction = 10.0,
+            .frictionCutoff = 0.1,
+            .jumpSpeed = 8.5,
+            .stopSpeed = 1.0,
+    });
+//    world.emplace<FlyPlayerMove>(ent, 5.0);
+    world.emplace<MoveStats>(ent);
+
+    auto playerDef = edyn::rigidbody_def{
+            .kind = edyn::rigidbody_kind::rb_dynamic,
+            .position = {0.0, 0.0, 5.0},
+            .gravity = edyn::vector3_zero,
+            .shape = edyn::capsule_shape{.radius = 0.5, .half_length = 0.5, .axis = edyn::coordinate_axis::z},
+            .continuous_contacts = true,
+            .presentation = false,
+            .sleeping_disabled = true,
+    };
+    playerDef.material->friction = 0.0;
+    edyn::make_rigidbody(ent, world, playerDef);
+    return ent;
+}
+
 void PlayerControllerPlugin::execute(App& app) {
     for (auto [ent, input, look]: app.logicWorld.view<const Input, Look>().each()) {
-        look += vec3{-input.cursorDelta.y, 0.0, input.cursorDelta.x};
-        look.x = std::clamp(look.x, -XLookCap, XLookCap);
-        look.z = std::fmod(look.z + Tau / 2.0, Tau) - Tau / 2.0;
-        look.y = input.lean * edyn::to_radians(15.0);
+        applyLook(input, look);
     }
 
     auto flyView = app.logicWorld.view<
@@ -53,62 +160,7 @@ void PlayerControllerPlugin::execute(App& app) {
     >();
     for (auto [ent, input, look, ts, move, pos, linVel]: groundedView.each()) {
         scalar dt = sec_t(ts.delta).count();
-        vec3 initVel = move.linVel;
-        vec3 endVel = initVel;
-        scalar lateralSpeed = length(to_vector2_xy(initVel));
-
-        edyn::raycast_result result = edyn::raycast(
-                app.logicWorld,
-                pos,
-                pos - vec3{0.0, 0.0, 1.0625},
-                [myEnt=ent](entt::entity hitEnt) { return hitEnt == myEnt; } // prevent self collisions
-        );
-        vec3 wishDir = edyn::rotate(fromEuler(look), {input.move.x * move.sideSpeed, input.move.y * move.fwdSpeed, 0.0});
-        scalar wishSpeed = length(wishDir);
-        if (wishSpeed > SCALAR_EPSILON)
-            wishDir /= wishSpeed;
-
-        bool isGrounded = result.entity != entt::null;
-
-        wishSpeed = std::min(wishSpeed, move.runSpeed);
-
-        if (auto* stats = app.logicWorld.try_get<MoveStats>(ent)) {
-            stats->wishDir = wishDir;
-            stats->wishSpeed = wishSpeed;
-            stats->lateralSpeed = lateralSpeed;
-        }
-
-        if (isGrounded) {
-            if (move.groundTick >= 1) {
-                if (lateralSpeed > move.frictionCutoff) {
-                    friction(move.friction, move.stopSpeed, lateralSpeed, endVel, dt);
-                } else {
-                    endVel.x = endVel.y = 0.0;
-                }
-                endVel.z = -0.0625;
-            }
-            accelerate(move.accel, wishDir, wishSpeed, endVel, dt);
-            if (input.jump.current) {
-                initVel.z = move.jumpSpeed;
-                endVel.z = initVel.z - move.gravity * dt;
-            }
-            move.groundTick = saturating_increment(move.groundTick);
-
-        } else {
-            move.groundTick = 0;
-            wishSpeed = std::min(wishSpeed, move.airSpeedCap);
-            accelerate(move.airAccel, wishDir, wishSpeed, endVel, dt);
-            endVel.z -= move.gravity * dt;
-            scalar airSpeed = length(to_vector2_xy(endVel));
-            if (airSpeed > move.maxAirSpeed) {
-                scalar ratio = move.maxAirSpeed / airSpeed;
-                endVel.x *= ratio;
-                endVel.y *= ratio;
-            }
-        }
-
-        move.linVel = endVel;
-        linVel = (initVel + endVel) * 0.5;
+        applyGroundedMove(app.logicWorld, ent, input, look, pos, move, linVel, dt, app.logicWorld.try_get<MoveStats>(ent));
         edyn::refresh<LinearVelocity>(app.logicWorld, ent);
     }
 }
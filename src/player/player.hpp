@@ -3,9 +3,24 @@
 #include "game_pch.hpp"
 
 #include "app.hpp"
+#include "state.hpp"
 #include "plugin.hpp"
 
+void applyLook(Input const& input, Look& look);
+
+/**
+ * @brief Works out the velocity a grounded player wants from its input, the same way for live ticks and replayed ones.
+ *        Only the velocity changes, moving the player is left to physics.
+ */
+void applyGroundedMove(World& world, entt::entity ent, Input const& input, Look const& look, Position const& pos,
+                       GroundedPlayerMove& move, LinearVelocity& linVel, scalar dt, MoveStats* stats = nullptr);
+
+/** @brief Creates a grounded player with its physics body, the same on clients and the server */
+entt::entity spawnPlayer(World& world, possesion_id_t possessionId);
+
 class PlayerControllerPlugin : public Plugin {
 public:
+    void access(SystemAccess& access) override;
+
     void execute(App& app) override;
 };
@@ -0,0 +1,131 @@
+#include "prediction.hpp"
+
+#include "app.hpp"
+#include "state.hpp"
+#include "player.hpp"
+
+// Differences below this are rounding, not the server disagreeing
+constexpr scalar CorrectionTolerance = 1e-3;
+
+bool isPredicted(World const& world, Player const& player) {
+    auto& local = world.ctx().at<LocalContext>();
+    return local.authority == Authority::Client && player.possessionId == local.possessionId;
+}
+
+bool isClose(PlayerSnapshot const& a, PlayerSnapshot const& b) {
+    constexpr scalar toleranceSqr = CorrectionTolerance * CorrectionTolerance;
+    return edyn::length_sqr(a.position - b.position) < toleranceSqr &&
+           edyn::length_sqr(a.linVel - b.linVel) < toleranceSqr;
+}
+
+/**
+ * @brief Moves a replayed player along one tick's step, stopping short of whatever the step would run into.
+ *        A single ray from the center, lengthened by how far the capsule reaches along the step,
+ *        so it catches the floor and walls the player is heading into but does not slide along them.
+ */
+void sweep(World& world, entt::entity ent, vec3& position, vec3& linVel, scalar dt) {
+    vec3 step = linVel * dt;
+    scalar distance = edyn::length(step);
+    if (distance < SCALAR_EPSILON) return;
+
+    vec3 dir = step / distance;
+    scalar reach = 0.0;
+    if (auto const* capsule = world.try_get<edyn::capsule_shape>(ent)) {
+        // Players are capsules along z, which reach furthest straight up or down
+        reach = capsule->radius + capsule->half_length * std::abs(dir.z);
+    }
+    edyn::raycast_result result = edyn::raycast(
+            world,
+            position,
+            position + dir * (distance + reach),
+            [myEnt=ent](entt::entity hitEnt) { return hitEnt == myEnt; }
+    );
+    if (result.entity == entt::null) {
+        position += step;
+        return;
+    }
+
+    position += dir * std::max(result.fraction * (distance + reach) - reach, 0.0);
+    // Like a contact would, the surface takes away the part of the velocity going into it
+    scalar intoSpeed = edyn::dot(linVel, result.normal);
+    if (intoSpeed < 0.0) linVel -= result.normal * intoSpeed;
+}
+
+/** @brief Puts the player back to the server's state if it disagrees with ours, then replays every tick since */
+void reconcile(App& app, PlayerSnapshot const& correction) {
+    World& world = app.logicWorld;
+    entt::entity ent = correction.ent;
+    if (!world.valid(ent) || !world.all_of<Player, GroundedPlayerMove>(ent)) return;
+    if (!isPredicted(world, world.get<Player>(ent))) return;
+
+    auto isOwn = [ent](auto const& record) { return record.ent == ent; };
+    // Too old to rewind to, the next correction will be recent enough
+    PlayerSnapshot* predicted = app.playerHistory.find(correction.tick, isOwn);
+    if (!predicted || isClose(*predicted, correction)) return;
+
+    auto& clock = app.globalCtx.at<SimulationClock>();
+    scalar dt = sec_t(clock.tickDelta).count();
+    PlayerSnapshot state = correction;
+    *predicted = state;
+    Input input{};
+    if (InputRecord const* record = app.inputHistory.find(correction.tick, isOwn)) {
+        input = record->input;
+    }
+    for (tick_t tick = correction.tick + 1; tick < clock.tick; ++tick) {
+        // A tick without a record had no input for this player, which is the same as repeating the last one
+        if (InputRecord const* record = app.inputHistory.find(tick, isOwn)) {
+            input = record->input;
+        }
+        applyLook(input, state.look);
+        applyGroundedMove(world, ent, input, state.look, state.position, state.move, state.linVel, dt);
+        // Only an approximation of the physics step: other bodies are where they are now, not where they were at this tick,
+        // and the player stops at what it hits instead of sliding along it, the next physics step resolves what is left
+        sweep(world, ent, state.position, state.linVel, dt);
+        state.tick = tick;
+        if (PlayerSnapshot* snapshot = app.playerHistory.find(tick, isOwn)) {
+            *snapshot = state;
+        }
+    }
+
+    world.replace<Position>(ent, state.position);
+    world.replace<LinearVelocity>(ent, state.linVel);
+    world.replace<Look>(ent, state.look);
+    world.replace<GroundedPlayerMove>(ent, state.move);
+    edyn::refresh<Position>(world, ent);
+    edyn::refresh<LinearVelocity>(world, ent);
+}
+
+void PredictionPlugin::build(App& app) {
+    app.globalCtx.emplace<ServerCorrections>();
+}
+
+void PredictionPlugin::access(SystemAccess& access) {
+    access.read<LogicWorldAccess, LocalContext, SimulationClock, InputHistory, Player>()
+            .write<ServerCorrections, PlayerHistory, Position, LinearVelocity, Look, GroundedPlayerMove>();
+}
+
+void PredictionPlugin::recordAccess(SystemAccess& access) {
+    access.read<LocalContext, SimulationClock, Player, Position, LinearVelocity, Look, GroundedPlayerMove>()
+            .write<PlayerHistory>();
+}
+
+void PredictionPlugin::execute(App& app) {
+    std::vector<PlayerSnapshot>& pending = app.globalCtx.at<ServerCorrections>().pending;
+    // Oldest first, a later correction then replays on top of an earlier one
+    std::sort(pending.begin(), pending.end(), [](PlayerSnapshot const& a, PlayerSnapshot const& b) { return a.tick < b.tick; });
+    for (PlayerSnapshot const& correction: pending) {
+        reconcile(app, correction);
+    }
+    pending.clear();
+}
+
+void PredictionPlugin::record(App& app) {
+    tick_t tick = app.globalCtx.at<SimulationClock>().tick;
+    app.playerHistory.begin_tick(tick);
+    auto view = app.logicWorld.view<const Player, const Position, const LinearVelocity, const Look, const GroundedPlayerMove>();
+    for (auto [ent, player, pos, linVel, look, move]: view.each()) {
+        if (!isPredicted(app.logicWorld, player)) continue;
+
+        app.playerHistory.push(tick, {tick, ent, pos, linVel, look, move});
+    }
+}
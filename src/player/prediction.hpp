@@ -0,0 +1,27 @@
+#pragma once
+
+#include "game_pch.hpp"
+
+#include "state.hpp"
+#include "plugin.hpp"
+
+/**
+ * @brief Client side prediction for the local player.
+ *
+ * The local player is simulated straight away from its own input and its state after every tick is remembered.
+ * When the server's state for a past tick disagrees, the player is put back to it and every tick since is replayed from the input history.
+ */
+class PredictionPlugin : public Plugin {
+public:
+    void build(App& app) override;
+
+    void access(SystemAccess& access) override;
+
+    /** @brief Applies server corrections, run at the start of a tick before anything is simulated */
+    void execute(App& app) override;
+
+    /** @brief Remembers how predicted players ended the tick, run after physics */
+    void record(App& app);
+
+    static void recordAccess(SystemAccess& access);
+};
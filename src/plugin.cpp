@@ -1 +1,18 @@
 #include "plugin.hpp"
+
+bool overlaps(std::vector<entt::id_type> const& a, std::vector<entt::id_type> const& b) {
+    return std::any_of(a.begin(), a.end(), [&](entt::id_type id) { return std::find(b.begin(), b.end(), id) != b.end(); });
+}
+
+SystemAccess& SystemAccess::merge(SystemAccess const& other) {
+    reads.insert(reads.end(), other.reads.begin(), other.reads.end());
+    writes.insert(writes.end(), other.writes.begin(), other.writes.end());
+    isExclusive |= other.isExclusive;
+    isMainThread |= other.isMainThread;
+    return *this;
+}
+
+bool SystemAccess::conflictsWith(SystemAccess const& other) const {
+    return isExclusive || other.isExclusive ||
+           overlaps(writes, other.writes) || overlaps(writes, other.reads) || overlaps(reads, other.writes);
+}
@@ -4,6 +4,45 @@
 
 struct App;
 
+/**
+ * @brief What a system touches, components and context resources alike are identified by their type.
+ *        The scheduler runs two systems at once only if neither writes something the other reads or writes.
+ */
+struct SystemAccess {
+    std::vector<entt::id_type> reads, writes;
+    // Conflicts with everything, the default for plugins that do not declare anything
+    bool isExclusive = false;
+    // Window and input APIs only work from the main thread
+    bool isMainThread = false;
+
+    template<typename... TTypes>
+    SystemAccess& read() {
+        (reads.push_back(entt::type_hash<TTypes>::value()), ...);
+        return *this;
+    }
+
+    template<typename... TTypes>
+    SystemAccess& write() {
+        (writes.push_back(entt::type_hash<TTypes>::value()), ...);
+        return *this;
+    }
+
+    SystemAccess& exclusive() {
+        isExclusive = true;
+        return *this;
+    }
+
+    SystemAccess& mainThread() {
+        isMainThread = true;
+        return *this;
+    }
+
+    /** @brief Adds everything the other touches, for systems that run a group of others */
+    SystemAccess& merge(SystemAccess const& other);
+
+    [[nodiscard]] bool conflictsWith(SystemAccess const& other) const;
+};
+
 class Plugin {
 public:
     virtual void build(App& app) {};
@@ -11,4 +50,9 @@ public:
     virtual void cleanup(App& app) {};
 
     virtual void execute(App& app) {};
+
+    /** @brief Declares what execute touches so it can be scheduled alongside other plugins */
+    virtual void access(SystemAccess& access) {
+        access.exclusive();
+    };
 };
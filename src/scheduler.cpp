@@ -0,0 +1,129 @@
+#include "scheduler.hpp"
+
+#include <mutex>
+#include <condition_variable>
+
+#include "thread_pool.hpp"
+
+// Weight of the newest sample in the moving average
+constexpr double TimingSmoothing = 0.05;
+
+void Scheduler::add(std::string name, SystemAccess access, std::function<void(App&)> run) {
+    size_t systemIdx = mSystems.size();
+    size_t dependencyCount = 0;
+    for (System& earlier: mSystems) {
+        if (earlier.access.conflictsWith(access)) {
+            earlier.dependents.push_back(systemIdx);
+            dependencyCount++;
+        }
+    }
+    mSystems.push_back({std::move(name), std::move(access), std::move(run), {}, dependencyCount, {}});
+    mTimings.push_back({mSystems.back().name});
+}
+
+void Scheduler::run(App& app, ThreadPool& pool) {
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::vector<size_t> remainingDeps(mSystems.size());
+    std::vector<size_t> mainReady;
+    size_t doneCount = 0;
+    std::exception_ptr error;
+
+    std::function<void(size_t)> execute;
+    // Hands systems whose dependencies are all done to whoever should run them
+    auto dispatch = [&](std::vector<size_t> const& ready) {
+        bool hasMainWork = false;
+        for (size_t systemIdx: ready) {
+            if (mSystems[systemIdx].access.isMainThread) {
+                std::lock_guard lock{mutex};
+                mainReady.push_back(systemIdx);
+                hasMainWork = true;
+            } else {
+                pool.post([&execute, systemIdx] { execute(systemIdx); });
+            }
+        }
+        if (hasMainWork) condition.notify_all();
+    };
+    execute = [&](size_t systemIdx) {
+        System& system = mSystems[systemIdx];
+        bool shouldRun;
+        {
+            std::lock_guard lock{mutex};
+            shouldRun = !error;
+        }
+        if (shouldRun) {
+            clock_point_t start = steady_clock_t::now();
+            try {
+                system.run(app);
+            } catch (...) {
+                std::lock_guard lock{mutex};
+                if (!error) error = std::current_exception();
+            }
+            system.duration = steady_clock_t::now() - start;
+        }
+
+        std::vector<size_t> ready;
+        {
+            std::lock_guard lock{mutex};
+            for (size_t dependentIdx: system.dependents) {
+                if (--remainingDeps[dependentIdx] == 0) ready.push_back(dependentIdx);
+            }
+        }
+        dispatch(ready);
+        // Counting ourselves as done must come last, the main thread may return and destroy all of this right after
+        std::lock_guard lock{mutex};
+        doneCount++;
+        condition.notify_all();
+    };
+
+    std::vector<size_t> roots;
+    for (size_t systemIdx = 0; systemIdx < mSystems.size(); ++systemIdx) {
+        remainingDeps[systemIdx] = mSystems[systemIdx].dependencyCount;
+        if (remainingDeps[systemIdx] == 0) roots.push_back(systemIdx);
+    }
+    dispatch(roots);
+
+    std::unique_lock lock{mutex};
+    while (doneCount < mSystems.size()) {
+        condition.wait(lock, [&] { return !mainReady.empty() || doneCount == mSystems.size(); });
+        while (!mainReady.empty()) {
+            size_t systemIdx = mainReady.back();
+            mainReady.pop_back();
+            lock.unlock();
+            execute(systemIdx);
+            lock.lock();
+        }
+    }
+    lock.unlock();
+
+    updateTimings();
+
+    if (error) std::rethrow_exception(error);
+}
+
+void Scheduler::runSerial(App& app) {
+    for (System& system: mSystems) {
+        clock_point_t start = steady_clock_t::now();
+        system.run(app);
+        system.duration = steady_clock_t::now() - start;
+    }
+    updateTimings();
+}
+
+SystemAccess Scheduler::access() const {
+    SystemAccess combined;
+    for (System const& system: mSystems) {
+        combined.merge(system.access);
+    }
+    return combined;
+}
+
+void Scheduler::updateTimings() {
+    for (size_t systemIdx = 0; systemIdx < mSystems.size(); ++systemIdx) {
+        SystemTiming& timing = mTimings[systemIdx];
+        timing.last = mSystems[systemIdx].duration;
+        timing.average = timing.average == clock_delta_t::zero()
+                         ? timing.last
+                         : std::chrono::duration_cast<clock_delta_t>(timing.average * (1.0 - TimingSmoothing) + timing.last * TimingSmoothing);
+    }
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "game_pch.hpp"
+
+#include <functional>
+
+#include "plugin.hpp"
+
+class ThreadPool;
+
+struct SystemTiming {
+    std::string name;
+    clock_delta_t last{}, average{};
+};
+
+/**
+ * @brief Runs systems as a dependency graph, in parallel wherever their declared access allows.
+ *
+ * A system depends on every system registered before it that it conflicts with,
+ * so registration order decides who goes first and the result always matches running them one by one in that order.
+ */
+class Scheduler {
+private:
+    struct System {
+        std::string name;
+        SystemAccess access;
+        std::function<void(App&)> run;
+        std::vector<size_t> dependents;
+        size_t dependencyCount{};
+        clock_delta_t duration{};
+    };
+
+    std::vector<System> mSystems;
+    // Only updated once a whole run has finished, so it can be read from any system
+    std::vector<SystemTiming> mTimings;
+
+    void updateTimings();
+
+public:
+    void add(std::string name, SystemAccess access, std::function<void(App&)> run);
+
+    template<std::derived_from<Plugin> TPlugin>
+    void add(std::string name, std::shared_ptr<TPlugin> const& plugin) {
+        SystemAccess access;
+        plugin->access(access);
+        add(std::move(name), std::move(access), [plugin](App& app) { plugin->execute(app); });
+    }
+
+    /**
+     * @brief Runs every system once and returns when all of them are done.
+     *        Must be called from the main thread, which runs main thread systems and otherwise waits.
+     *        Rethrows the first exception a system threw, systems that would have run after it are skipped.
+     */
+    void run(App& app, ThreadPool& pool);
+
+    /**
+     * @brief Runs every system once on the calling thread in registration order.
+     *        For schedules that run many times inside another system, where ordering has to be deterministic.
+     */
+    void runSerial(App& app);
+
+    /** @brief Everything the systems touch combined */
+    [[nodiscard]] SystemAccess access() const;
+
+    [[nodiscard]] std::vector<SystemTiming> const& timings() const {
+        return mTimings;
+    }
+};
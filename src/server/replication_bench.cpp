@@ -0,0 +1,76 @@
+#include "replication_bench.hpp"
+
+#include <thread>
+#include <random>
+
+#include "app.hpp"
+#include "net/replication.hpp"
+
+constexpr scalar BenchWorldSize = 256.0;
+
+void runReplicationBenchmark(size_t entityCount, size_t clientCount, tick_t tickCount) {
+    App server{1};
+    auto& clock = server.globalCtx.emplace<SimulationClock>(SimulationClock{
+            .tickDelta = std::chrono::duration_cast<clock_delta_t>(sec_t{1.0 / 64.0}),
+            .lastPoint = steady_clock_t::now()
+    });
+    // Port zero picks a free one, so benchmarks never collide with a running server
+    auto serverPlugin = server.makePlugin<ReplicationServerPlugin>(uint16_t{0});
+
+    std::mt19937 rng{42};
+    std::uniform_real_distribution<scalar> positionDist{-BenchWorldSize / 2.0, BenchWorldSize / 2.0};
+    std::uniform_real_distribution<scalar> velocityDist{-4.0, 4.0};
+    for (size_t entityIdx = 0; entityIdx < entityCount; ++entityIdx) {
+        entt::entity ent = server.logicWorld.create();
+        server.logicWorld.emplace<Position>(ent, positionDist(rng), positionDist(rng), 0.0);
+        server.logicWorld.emplace<Orientation>(ent, edyn::quaternion_identity);
+        bool isMoving = entityIdx % 4 == 0;
+        server.logicWorld.emplace<LinearVelocity>(ent, isMoving ? vec3{velocityDist(rng), velocityDist(rng), 0.0} : edyn::vector3_zero);
+    }
+
+    std::vector<std::unique_ptr<App>> clients;
+    std::vector<std::shared_ptr<ReplicationClientPlugin>> clientPlugins;
+    for (size_t clientIdx = 0; clientIdx < clientCount; ++clientIdx) {
+        auto possessionId = static_cast<possesion_id_t>(clientIdx);
+        entt::entity playerEnt = server.logicWorld.create();
+        server.logicWorld.emplace<Player>(playerEnt, possessionId);
+        server.logicWorld.emplace<Position>(playerEnt, positionDist(rng), positionDist(rng), 0.0);
+        server.logicWorld.emplace<Look>(playerEnt);
+
+        auto& client = clients.emplace_back(std::make_unique<App>(size_t{1}));
+        clientPlugins.push_back(client->makePlugin<ReplicationClientPlugin>(NetAddress::loopback(serverPlugin->port()), possessionId));
+    }
+
+    scalar dt = sec_t(clock.tickDelta).count();
+    clock_delta_t serverTime{}, clientTime{};
+    for (tick_t tick = 0; tick < tickCount; ++tick) {
+        for (auto [ent, pos, linVel]: server.logicWorld.view<Position, const LinearVelocity>().each()) {
+            pos += linVel * dt;
+        }
+        clock.tick++;
+
+        clock_point_t serverStart = steady_clock_t::now();
+        serverPlugin->execute(server);
+        serverTime += steady_clock_t::now() - serverStart;
+
+        // Loopback delivers right away, the yield just lets the datagrams land
+        std::this_thread::yield();
+        clock_point_t clientStart = steady_clock_t::now();
+        for (size_t clientIdx = 0; clientIdx < clientCount; ++clientIdx) {
+            clientPlugins[clientIdx]->execute(*clients[clientIdx]);
+        }
+        clientTime += steady_clock_t::now() - clientStart;
+    }
+
+    auto const& stats = server.globalCtx.at<ReplicationStats>();
+    double perClientTick = static_cast<double>(std::max<size_t>(stats.packetsSent, 1));
+    std::cout << "[Bench]" << " " << entityCount << " entities, " << clientCount << " clients, " << tickCount << " ticks" << std::endl;
+    std::cout << "[Bench]" << " Snapshots sent: " << stats.packetsSent << ", acks received: " << stats.packetsReceived << std::endl;
+    std::cout << "[Bench]" << " Bytes per snapshot: " << static_cast<double>(stats.bytesSent) / perClientTick
+              << ", per client per second: " << static_cast<double>(stats.bytesSent) / perClientTick / dt / 1024.0 << " KiB" << std::endl;
+    std::cout << "[Bench]" << " Server per tick: " << ms_t(serverTime).count() / tickCount << " ms"
+              << ", clients per tick: " << ms_t(clientTime).count() / tickCount << " ms" << std::endl;
+    if (!clients.empty()) {
+        std::cout << "[Bench]" << " Entities on the first client: " << clients.front()->logicWorld.alive() << std::endl;
+    }
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include "game_pch.hpp"
+
+#include "state.hpp"
+
+/**
+ * @brief Replicates a world of entities to clients over loopback and reports bandwidth and encoding cost.
+ *        A quarter of the entities move every tick, the rest stay put so deltas have something to skip.
+ */
+void runReplicationBenchmark(size_t entityCount, size_t clientCount, tick_t tickCount);
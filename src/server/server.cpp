@@ -0,0 +1,77 @@
+#include <span>
+#include <thread>
+#include <csignal>
+
+#include "app.hpp"
+#include "state.hpp"
+#include "level.hpp"
+#include "simulation.hpp"
+#include "player/player.hpp"
+#include "physics/physics.hpp"
+#include "net/replication.hpp"
+#include "replication_bench.hpp"
+
+volatile std::sig_atomic_t gIsRunning = true;
+
+// Headless, so stopping is left to the process manager
+void onStopSignal(int) {
+    gIsRunning = false;
+}
+
+/** @brief Reads the number following a flag, or the fallback if the flag is not there */
+size_t argValue(std::span<char*> args, std::string_view flag, size_t argIdx, size_t fallback) {
+    auto it = std::find(args.begin(), args.end(), flag);
+    if (it == args.end()) return fallback;
+    if (std::distance(it, args.end()) <= static_cast<ptrdiff_t>(argIdx)) throw std::runtime_error("Missing value for " + std::string{flag});
+
+    return std::stoull(*(it + static_cast<ptrdiff_t>(argIdx)));
+}
+
+int main(int argc, char** argv) {
+    try {
+        std::signal(SIGINT, onStopSignal);
+        std::signal(SIGTERM, onStopSignal);
+
+        register_reflection();
+
+        std::span<char*> args{argv, static_cast<size_t>(argc)};
+        // --bench <entities> <clients> <ticks> replicates a generated world over loopback instead of running a match
+        if (std::find(args.begin(), args.end(), "--bench"sv) != args.end()) {
+            runReplicationBenchmark(argValue(args, "--bench", 1, 1000), argValue(args, "--bench", 2, 8), static_cast<tick_t>(argValue(args, "--bench", 3, 640)));
+            return EXIT_SUCCESS;
+        }
+        auto port = static_cast<uint16_t>(argValue(args, "--port", 1, DefaultServerPort));
+
+        // Ticks run serially, so one worker is all the frame schedule needs and many instances can share a host
+        App app{1};
+        auto simulationPlugin = app.makePlugin<SimulationPlugin>();
+        auto physicsPlugin = app.makePlugin<PhysicsPlugin>();
+        auto playerControllerPlugin = app.makePlugin<PlayerControllerPlugin>();
+        auto replicationPlugin = app.makePlugin<ReplicationServerPlugin>(port);
+        // The same level clients build, so players spawned for them have ground to stand on
+        auto levelPlugin = app.makePlugin<LevelPlugin>();
+
+        app.logicWorld.ctx().emplace<LocalContext>(std::nullopt, Authority::Server);
+
+        Scheduler& ticks = simulationPlugin->ticks();
+        ticks.add("Animate", levelPlugin);
+        ticks.add("Player Controller", playerControllerPlugin);
+        ticks.add("Physics", physicsPlugin);
+
+        app.scheduler.add("Simulation", simulationPlugin);
+        app.scheduler.add("Replication", replicationPlugin);
+
+        std::cout << "[Server]" << " Running at " << 1.0 / sec_t(app.globalCtx.at<SimulationClock>().tickDelta).count() << " ticks per second" << std::endl;
+        while (gIsRunning) {
+            app.scheduler.run(app, app.threadPool);
+            // There is nothing to draw in between, so sleep until there is a whole tick to simulate
+            std::this_thread::sleep_until(app.globalCtx.at<SimulationClock>().nextTickPoint());
+        }
+        std::cout << "[Server]" << " Stopping" << std::endl;
+    }
+    catch (std::exception const& err) {
+        std::cerr << "exception: " << err.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,70 @@
+#include "simulation.hpp"
+
+#include "app.hpp"
+#include "state.hpp"
+
+bool isSameTransform(PreviousTransform const& prev, Position const& pos, Orientation const& orien) {
+    return prev.position == pos &&
+           prev.orientation.x == orien.x && prev.orientation.y == orien.y &&
+           prev.orientation.z == orien.z && prev.orientation.w == orien.w;
+}
+
+/** @brief Remembers where everything rendered is before a tick moves it */
+void snapshotTransforms(World& world) {
+    for (auto [ent, pos, orien]: world.view<const Position, const Orientation>().each()) {
+        if (!world.any_of<ModelHandle, Player>(ent)) continue;
+
+        // Only written when it changes so resting entities stop being picked up as modified by extraction
+        auto* prev = world.try_get<PreviousTransform>(ent);
+        if (!prev) {
+            world.emplace<PreviousTransform>(ent, pos, orien);
+        } else if (!isSameTransform(*prev, pos, orien)) {
+            world.replace<PreviousTransform>(ent, pos, orien);
+        }
+    }
+}
+
+void SimulationPlugin::build(App& app) {
+    GAME_ASSERT(mTickRate > 0);
+    auto tickDelta = std::chrono::duration_cast<clock_delta_t>(sec_t{1.0 / mTickRate});
+    app.globalCtx.emplace<SimulationClock>(SimulationClock{.tickDelta = tickDelta, .lastPoint = steady_clock_t::now()});
+}
+
+void SimulationPlugin::access(SystemAccess& access) {
+    access.merge(mTicks.access())
+            .read<Player, ModelHandle>()
+            .write<LogicWorldAccess, SimulationClock, Timestamp, PreviousTransform, Input>();
+}
+
+void SimulationPlugin::execute(App& app) {
+    auto& clock = app.globalCtx.at<SimulationClock>();
+    clock_point_t now = steady_clock_t::now();
+    clock.accumulator += now - clock.lastPoint;
+    clock.lastPoint = now;
+
+    uint32_t tickCount = 0;
+    while (clock.accumulator >= clock.tickDelta) {
+        if (tickCount == mMaxTicksPerFrame) {
+            // Drop the time we could not keep up with, otherwise every following frame would be stuck catching up
+            clock.accumulator = clock_delta_t::zero();
+            break;
+        }
+        snapshotTransforms(app.logicWorld);
+        // Simulated time, which only depends on the tick so replaying a tick sees the same timestamps
+        clock_point_t tickPoint{clock.tickDelta * clock.tick};
+        for (auto [ent, timestamp]: app.logicWorld.view<Timestamp>().each()) {
+            timestamp = {tickPoint, clock.tickDelta};
+        }
+
+        mTicks.runSerial(app);
+
+        // Mouse movement is accumulated over a frame, only the first tick gets to apply it
+        for (auto [ent, input]: app.logicWorld.view<Input>().each()) {
+            input.cursorDelta = {};
+        }
+        clock.accumulator -= clock.tickDelta;
+        clock.tick++;
+        tickCount++;
+    }
+    clock.alpha = sec_t(clock.accumulator) / sec_t(clock.tickDelta);
+}
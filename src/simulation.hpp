@@ -0,0 +1,38 @@
+#pragma once
+
+#include "game_pch.hpp"
+
+#include "plugin.hpp"
+#include "scheduler.hpp"
+
+/**
+ * @brief Steps the simulation in fixed ticks no matter how fast frames are rendered.
+ *
+ * Real time is accumulated every frame and as many whole ticks as fit are run, the remainder carries over.
+ * The fraction of a tick left over is handed to rendering, which blends between the last two ticks with it.
+ */
+class SimulationPlugin : public Plugin {
+public:
+    /**
+     * @param tickRate          Ticks per second
+     * @param maxTicksPerFrame  Caps how far the simulation may catch up in one frame,
+     *                          past that it falls behind real time instead of taking ever longer frames
+     */
+    explicit SimulationPlugin(uint32_t tickRate = 64, uint32_t maxTicksPerFrame = 8)
+            : mTickRate(tickRate), mMaxTicksPerFrame(maxTicksPerFrame) {}
+
+    void build(App& app) override;
+
+    void access(SystemAccess& access) override;
+
+    void execute(App& app) override;
+
+    /** @brief Systems that run once per tick, register them before adding this plugin to the frame scheduler */
+    Scheduler& ticks() {
+        return mTicks;
+    }
+
+private:
+    uint32_t mTickRate, mMaxTicksPerFrame;
+    Scheduler mTicks;
+};
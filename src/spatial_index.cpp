@@ -0,0 +1,300 @@
+#include "spatial_index.hpp"
+
+BoundingBox merge(BoundingBox const& a, BoundingBox const& b) {
+    return {edyn::min(a.min, b.min), edyn::max(a.max, b.max)};
+}
+
+bool encloses(BoundingBox const& outer, BoundingBox const& inner) {
+    return outer.min.x <= inner.min.x && outer.min.y <= inner.min.y && outer.min.z <= inner.min.z &&
+           outer.max.x >= inner.max.x && outer.max.y >= inner.max.y && outer.max.z >= inner.max.z;
+}
+
+/** @brief Surface area, which is proportional to how likely a random ray or box is to hit the box */
+scalar area(BoundingBox const& box) {
+    vec3 size = box.max - box.min;
+    return 2.0 * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+bool SpatialIndex::intersects(BoundingBox const& box, vec3 const& center, scalar radius) {
+    vec3 closest = edyn::min(edyn::max(center, box.min), box.max);
+    return edyn::length_sqr(closest - center) <= radius * radius;
+}
+
+std::optional<scalar> SpatialIndex::intersects(BoundingBox const& box, vec3 const& origin, vec3 const& invDir, scalar maxDistance) {
+    // Slab test, a zero direction component divides to infinity which the comparisons handle
+    scalar enter = 0.0, exit = maxDistance;
+    for (size_t i = 0; i < 3; ++i) {
+        scalar t0 = (box.min[i] - origin[i]) * invDir[i];
+        scalar t1 = (box.max[i] - origin[i]) * invDir[i];
+        if (t0 > t1) std::swap(t0, t1);
+        enter = std::max(enter, t0);
+        exit = std::min(exit, t1);
+        if (enter > exit) return std::nullopt;
+    }
+    return enter;
+}
+
+void SpatialIndex::insert(entt::entity ent, BoundingBox const& box) {
+    if (mLeaves.contains(ent)) {
+        update(ent, box);
+        return;
+    }
+
+    int32_t leafIdx = allocateNode();
+    Node& leaf = mNodes[leafIdx];
+    vec3 margin{mMargin, mMargin, mMargin};
+    leaf.box = {box.min - margin, box.max + margin};
+    leaf.height = 0;
+    leaf.ent = ent;
+    mLeaves.emplace(ent, leafIdx);
+    insertLeaf(leafIdx);
+}
+
+void SpatialIndex::remove(entt::entity ent) {
+    auto it = mLeaves.find(ent);
+    GAME_ASSERT(it != mLeaves.end());
+    removeLeaf(it->second);
+    freeNode(it->second);
+    mLeaves.erase(it);
+}
+
+bool SpatialIndex::update(entt::entity ent, BoundingBox const& box) {
+    auto it = mLeaves.find(ent);
+    if (it == mLeaves.end()) {
+        insert(ent, box);
+        return true;
+    }
+
+    int32_t leafIdx = it->second;
+    if (encloses(mNodes[leafIdx].box, box)) return false;
+
+    removeLeaf(leafIdx);
+    vec3 margin{mMargin, mMargin, mMargin};
+    mNodes[leafIdx].box = {box.min - margin, box.max + margin};
+    insertLeaf(leafIdx);
+    return true;
+}
+
+int32_t SpatialIndex::allocateNode() {
+    int32_t nodeIdx;
+    if (mFreeList == NullNode) {
+        nodeIdx = static_cast<int32_t>(mNodes.size());
+        mNodes.emplace_back();
+    } else {
+        nodeIdx = mFreeList;
+        mFreeList = mNodes[nodeIdx].parent;
+    }
+    Node& node = mNodes[nodeIdx];
+    node.parent = node.left = node.right = NullNode;
+    node.height = 0;
+    node.ent = entt::null;
+    return nodeIdx;
+}
+
+void SpatialIndex::freeNode(int32_t nodeIdx) {
+    mNodes[nodeIdx].parent = mFreeList;
+    mNodes[nodeIdx].height = -1;
+    mFreeList = nodeIdx;
+}
+
+void SpatialIndex::insertLeaf(int32_t leafIdx) {
+    if (mRoot == NullNode) {
+        mRoot = leafIdx;
+        mNodes[leafIdx].parent = NullNode;
+        return;
+    }
+
+    // Walk down towards whichever child grows the least, stopping where pairing up with the node itself is cheaper
+    BoundingBox leafBox = mNodes[leafIdx].box;
+    int32_t siblingIdx = mRoot;
+    while (!mNodes[siblingIdx].isLeaf()) {
+        Node const& node = mNodes[siblingIdx];
+        scalar nodeArea = area(node.box);
+        scalar mergedArea = area(merge(node.box, leafBox));
+        // Creating a parent here costs its area, going further down grows this node's box for everyone below
+        scalar pairCost = 2.0 * mergedArea;
+        scalar inheritedCost = 2.0 * (mergedArea - nodeArea);
+        auto descendCost = [&](int32_t childIdx) {
+            Node const& child = mNodes[childIdx];
+            scalar grownArea = area(merge(leafBox, child.box));
+            return (child.isLeaf() ? grownArea : grownArea - area(child.box)) + inheritedCost;
+        };
+        scalar leftCost = descendCost(node.left), rightCost = descendCost(node.right);
+        if (pairCost < leftCost && pairCost < rightCost) break;
+
+        siblingIdx = leftCost < rightCost ? node.left : node.right;
+    }
+
+    // Allocating may grow the node storage, so no references are held across it
+    int32_t newParentIdx = allocateNode();
+    int32_t oldParentIdx = mNodes[siblingIdx].parent;
+    Node& newParent = mNodes[newParentIdx];
+    newParent.parent = oldParentIdx;
+    newParent.box = merge(leafBox, mNodes[siblingIdx].box);
+    newParent.height = mNodes[siblingIdx].height + 1;
+    newParent.left = siblingIdx;
+    newParent.right = leafIdx;
+    if (oldParentIdx == NullNode) {
+        mRoot = newParentIdx;
+    } else if (mNodes[oldParentIdx].left == siblingIdx) {
+        mNodes[oldParentIdx].left = newParentIdx;
+    } else {
+        mNodes[oldParentIdx].right = newParentIdx;
+    }
+    mNodes[siblingIdx].parent = newParentIdx;
+    mNodes[leafIdx].parent = newParentIdx;
+
+    refitAncestors(newParentIdx);
+}
+
+void SpatialIndex::removeLeaf(int32_t leafIdx) {
+    if (leafIdx == mRoot) {
+        mRoot = NullNode;
+        return;
+    }
+
+    // The leaf's parent goes away and its sibling takes the parent's place
+    int32_t parentIdx = mNodes[leafIdx].parent;
+    int32_t grandParentIdx = mNodes[parentIdx].parent;
+    int32_t siblingIdx = mNodes[parentIdx].left == leafIdx ? mNodes[parentIdx].right : mNodes[parentIdx].left;
+    mNodes[siblingIdx].parent = grandParentIdx;
+    freeNode(parentIdx);
+    if (grandParentIdx == NullNode) {
+        mRoot = siblingIdx;
+        return;
+    }
+
+    if (mNodes[grandParentIdx].left == parentIdx) {
+        mNodes[grandParentIdx].left = siblingIdx;
+    } else {
+        mNodes[grandParentIdx].right = siblingIdx;
+    }
+    refitAncestors(grandParentIdx);
+}
+
+void SpatialIndex::refitAncestors(int32_t nodeIdx) {
+    while (nodeIdx != NullNode) {
+        nodeIdx = balance(nodeIdx);
+        Node& node = mNodes[nodeIdx];
+        Node const& left = mNodes[node.left];
+        Node const& right = mNodes[node.right];
+        node.box = merge(left.box, right.box);
+        node.height = 1 + std::max(left.height, right.height);
+        nodeIdx = node.parent;
+    }
+}
+
+int32_t SpatialIndex::balance(int32_t aIdx) {
+    Node& a = mNodes[aIdx];
+    if (a.isLeaf() || a.height < 2) return aIdx;
+
+    // Whichever child is more than one level taller is rotated up into a's place, a takes its shorter grandchild
+    int32_t bIdx = a.left, cIdx = a.right;
+    int32_t balance = mNodes[cIdx].height - mNodes[bIdx].height;
+    if (balance >= -1 && balance <= 1) return aIdx;
+
+    bool isRightTaller = balance > 1;
+    int32_t upIdx = isRightTaller ? cIdx : bIdx;
+    int32_t keptIdx = isRightTaller ? bIdx : cIdx;
+    Node& up = mNodes[upIdx];
+    int32_t fIdx = up.left, gIdx = up.right;
+
+    up.left = aIdx;
+    up.parent = a.parent;
+    a.parent = upIdx;
+    if (up.parent == NullNode) {
+        mRoot = upIdx;
+    } else if (mNodes[up.parent].left == aIdx) {
+        mNodes[up.parent].left = upIdx;
+    } else {
+        mNodes[up.parent].right = upIdx;
+    }
+
+    // The taller grandchild stays with the rotated node, the shorter one moves under a
+    bool isFTaller = mNodes[fIdx].height > mNodes[gIdx].height;
+    int32_t stayIdx = isFTaller ? fIdx : gIdx;
+    int32_t moveIdx = isFTaller ? gIdx : fIdx;
+    up.right = stayIdx;
+    if (isRightTaller) {
+        a.right = moveIdx;
+    } else {
+        a.left = moveIdx;
+    }
+    mNodes[moveIdx].parent = aIdx;
+
+    Node const& kept = mNodes[keptIdx];
+    Node const& moved = mNodes[moveIdx];
+    Node const& stayed = mNodes[stayIdx];
+    a.box = merge(kept.box, moved.box);
+    a.height = 1 + std::max(kept.height, moved.height);
+    up.box = merge(a.box, stayed.box);
+    up.height = 1 + std::max(a.height, stayed.height);
+    return upIdx;
+}
+
+void SpatialIndexTracker::connect(World& world) {
+    mObserver.connect(world, entt::collector
+            .group<Position, ModelHandle>()
+            .update<Position>().where<ModelHandle>()
+            .update<ModelHandle>().where<Position>()
+            .update<PreviousTransform>().where<Position, ModelHandle>());
+    world.on_destroy<Position>().connect<&SpatialIndexTracker::onRemoved>(*this);
+    world.on_destroy<ModelHandle>().connect<&SpatialIndexTracker::onRemoved>(*this);
+}
+
+void SpatialIndexTracker::disconnect(World& world) {
+    mObserver.disconnect();
+    world.on_destroy<Position>().disconnect(*this);
+    world.on_destroy<ModelHandle>().disconnect(*this);
+}
+
+bool SpatialIndexTracker::isIndexable(World const& world, entt::entity ent) {
+    return world.valid(ent) && world.all_of<Position, ModelHandle>(ent);
+}
+
+BoundingBox SpatialIndexTracker::calcBox(World const& world, entt::entity ent, Bounds const& bounds) {
+    auto const& pos = world.get<Position>(ent);
+    BoundingBox box{pos + bounds.min, pos + bounds.max};
+    if (auto* prev = world.try_get<PreviousTransform>(ent)) {
+        box = merge(box, {prev->position + bounds.min, prev->position + bounds.max});
+    }
+    return box;
+}
+
+void SpatialIndexTracker::onRemoved(entt::registry&, entt::entity ent) {
+    mRemoved.push_back(ent);
+}
+
+void SpatialIndexPlugin::build(App& app) {
+    app.logicWorld.ctx().emplace<SpatialIndex>();
+    mTracker.connect(app.logicWorld);
+}
+
+void SpatialIndexPlugin::access(SystemAccess& access) {
+    access.read<LogicWorldAccess, Position, PreviousTransform, ModelHandle, ModelAssets>()
+            .write<SpatialIndex>();
+}
+
+void SpatialIndexPlugin::execute(App& app) {
+    World const& world = app.logicWorld;
+    auto& index = app.logicWorld.ctx().at<SpatialIndex>();
+    // Models are loaded by the renderer, an entity is indexed once its model has been
+    auto boundsOf = [&](asset_handle_t handle) -> Bounds const* {
+        auto it = mModelBounds.find(handle);
+        if (it != mModelBounds.end()) return &it->second;
+        if (!app.modelAssets.contains(handle)) return nullptr;
+
+        return &mModelBounds.emplace(handle, calcModelBounds(*app.modelAssets[handle])).first->second;
+    };
+    mTracker.update(world, index, boundsOf);
+
+    // Physics moves bodies in place without patching, so they are refreshed every frame
+    // Most of them stay within their fattened boxes, which makes this cheap
+    for (entt::entity ent: world.view<const edyn::dynamic_tag, const Position, const ModelHandle>()) {
+        mTracker.refresh(world, index, ent, boundsOf);
+    }
+}
+
+void SpatialIndexPlugin::cleanup(App& app) {
+    mTracker.disconnect(app.logicWorld);
+}
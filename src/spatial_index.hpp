@@ -0,0 +1,231 @@
+#pragma once
+
+#include "game_pch.hpp"
+
+#include "app.hpp"
+#include "state.hpp"
+#include "assets.hpp"
+#include "plugin.hpp"
+
+struct BoundingBox {
+    vec3 min, max;
+};
+
+struct RayHit {
+    entt::entity ent;
+    // Along the ray to where it enters the entity's box, in units of the ray direction
+    scalar distance;
+};
+
+/**
+ * @brief Dynamic bounding volume tree over entity boxes, for visibility and gameplay queries that would otherwise scan everything.
+ *
+ * Leaves hold boxes fattened by a margin, so an entity that moves a little stays in its leaf and costs nothing.
+ * Leaves are placed where they grow the tree's surface area the least and the tree is kept balanced by rotations,
+ * the same scheme physics broadphases commonly use.
+ */
+class SpatialIndex {
+public:
+    static constexpr int32_t NullNode = -1;
+
+    /** @param margin   How far boxes are fattened on every side */
+    explicit SpatialIndex(scalar margin = 0.5) : mMargin(margin) {}
+
+    /** @brief Inserts the entity, or moves it if it is already in the index */
+    void insert(entt::entity ent, BoundingBox const& box);
+
+    void remove(entt::entity ent);
+
+    /** @return Whether the entity's leaf had to be moved, which only happens once it leaves its fattened box */
+    bool update(entt::entity ent, BoundingBox const& box);
+
+    [[nodiscard]] bool contains(entt::entity ent) const {
+        return mLeaves.contains(ent);
+    }
+
+    [[nodiscard]] size_t size() const {
+        return mLeaves.size();
+    }
+
+    [[nodiscard]] int32_t height() const {
+        return mRoot == NullNode ? 0 : mNodes[mRoot].height;
+    }
+
+    /**
+     * @brief Visits every entity whose fattened box passes the test, subtrees whose box fails are skipped entirely.
+     * @param test  Called with node boxes, must hold for a box whenever it holds for any box inside it
+     */
+    template<typename TTest, typename TVisit>
+    void query(TTest&& test, TVisit&& visit) const {
+        if (mRoot == NullNode) return;
+
+        std::vector<int32_t> stack;
+        stack.reserve(64);
+        stack.push_back(mRoot);
+        while (!stack.empty()) {
+            Node const& node = mNodes[stack.back()];
+            stack.pop_back();
+            if (!test(node.box)) continue;
+
+            if (node.isLeaf()) {
+                visit(node.ent);
+            } else {
+                stack.push_back(node.left);
+                stack.push_back(node.right);
+            }
+        }
+    }
+
+    template<typename TVisit>
+    void querySphere(vec3 const& center, scalar radius, TVisit&& visit) const {
+        query([&](BoundingBox const& box) { return intersects(box, center, radius); }, std::forward<TVisit>(visit));
+    }
+
+    /**
+     * @brief Finds the nearest entity box the ray enters, subtrees further than the nearest hit so far are skipped.
+     * @param accept    Called with candidate entities, returning false ignores one, for example the entity casting the ray
+     */
+    template<typename TAccept>
+    std::optional<RayHit> raycast(vec3 const& origin, vec3 const& dir, scalar maxDistance, TAccept&& accept) const {
+        if (mRoot == NullNode) return std::nullopt;
+
+        vec3 invDir{1.0 / dir.x, 1.0 / dir.y, 1.0 / dir.z};
+        std::optional<RayHit> nearest;
+        std::vector<int32_t> stack;
+        stack.reserve(64);
+        stack.push_back(mRoot);
+        while (!stack.empty()) {
+            Node const& node = mNodes[stack.back()];
+            stack.pop_back();
+            std::optional<scalar> distance = intersects(node.box, origin, invDir, nearest ? nearest->distance : maxDistance);
+            if (!distance) continue;
+
+            if (!node.isLeaf()) {
+                stack.push_back(node.left);
+                stack.push_back(node.right);
+            } else if (accept(node.ent)) {
+                nearest = RayHit{node.ent, *distance};
+            }
+        }
+        return nearest;
+    }
+
+    static bool intersects(BoundingBox const& box, vec3 const& center, scalar radius);
+
+    /** @return Distance along the ray to where it enters the box, if it does so before maxDistance */
+    static std::optional<scalar> intersects(BoundingBox const& box, vec3 const& origin, vec3 const& invDir, scalar maxDistance);
+
+private:
+    struct Node {
+        BoundingBox box;
+        // Doubles as the next free node while the node is unused
+        int32_t parent;
+        int32_t left, right;
+        // Leaves are zero, unused nodes are negative
+        int32_t height;
+        entt::entity ent;
+
+        [[nodiscard]] bool isLeaf() const {
+            return left == NullNode;
+        }
+    };
+
+    scalar mMargin;
+    std::vector<Node> mNodes;
+    int32_t mRoot = NullNode;
+    int32_t mFreeList = NullNode;
+    std::unordered_map<entt::entity, int32_t> mLeaves;
+
+    int32_t allocateNode();
+
+    void freeNode(int32_t nodeIdx);
+
+    void insertLeaf(int32_t leafIdx);
+
+    void removeLeaf(int32_t leafIdx);
+
+    /** @brief Refits boxes and heights from a node up to the root, rebalancing along the way */
+    void refitAncestors(int32_t nodeIdx);
+
+    /** @return Index of the node now at the position of the given one */
+    int32_t balance(int32_t nodeIdx);
+};
+
+/**
+ * @brief Keeps a spatial index of a world's entities with a model up to date through the world's signals.
+ *
+ * Boxes come from the model bounds at the entity's position, joined with its previous position when it has one
+ * so that interpolated rendering stays inside. Entities whose model bounds are not known yet are retried on every update.
+ */
+class SpatialIndexTracker {
+public:
+    void connect(World& world);
+
+    void disconnect(World& world);
+
+    /** @param boundsOf    Returns the bounds of a model, or null if they are not known yet */
+    template<typename TBoundsOf>
+    void update(World const& world, SpatialIndex& index, TBoundsOf&& boundsOf) {
+        for (entt::entity ent: mRemoved) {
+            if (!isIndexable(world, ent) && index.contains(ent)) index.remove(ent);
+        }
+        mRemoved.clear();
+
+        std::vector<entt::entity> dirty(mObserver.begin(), mObserver.end());
+        mObserver.clear();
+        dirty.insert(dirty.end(), mPending.begin(), mPending.end());
+        mPending.clear();
+        // Something that changed while waiting on its model is in both
+        std::sort(dirty.begin(), dirty.end());
+        dirty.erase(std::unique(dirty.begin(), dirty.end()), dirty.end());
+        for (entt::entity ent: dirty) {
+            refresh(world, index, ent, boundsOf);
+        }
+    }
+
+    /** @brief Updates an entity right away, for ones that move without notifying anyone */
+    template<typename TBoundsOf>
+    void refresh(World const& world, SpatialIndex& index, entt::entity ent, TBoundsOf&& boundsOf) {
+        if (!isIndexable(world, ent)) return;
+
+        Bounds const* bounds = boundsOf(world.get<ModelHandle>(ent).value);
+        if (!bounds) {
+            mPending.insert(ent);
+            return;
+        }
+        index.update(ent, calcBox(world, ent, *bounds));
+    }
+
+private:
+    entt::observer mObserver;
+    std::vector<entt::entity> mRemoved;
+    // A set since entities that move every tick would otherwise be added again each time until their model loads
+    std::unordered_set<entt::entity> mPending;
+
+    static bool isIndexable(World const& world, entt::entity ent);
+
+    static BoundingBox calcBox(World const& world, entt::entity ent, Bounds const& bounds);
+
+    void onRemoved(entt::registry& registry, entt::entity ent);
+};
+
+/**
+ * @brief Maintains the logic world's spatial index in its context, which gameplay and the inspector query.
+ *
+ * Client side only: bounds come from the loaded models, which only the renderer loads.
+ * On the dedicated server nothing would ever be indexed, so the server does not add this plugin.
+ */
+class SpatialIndexPlugin : public Plugin {
+public:
+    void build(App& app) override;
+
+    void access(SystemAccess& access) override;
+
+    void execute(App& app) override;
+
+    void cleanup(App& app) override;
+
+private:
+    SpatialIndexTracker mTracker;
+    std::unordered_map<asset_handle_t, Bounds> mModelBounds;
+};
@@ -14,6 +14,7 @@ using LinearVelocity = edyn::linvel;
 using possesion_id_t = uint8_t;
 using asset_handle_t = entt::id_type;
 using equip_idx_t = uint8_t;
+using tick_t = uint32_t;
 
 struct GameSettings {
     scalar gravity;
@@ -40,6 +41,26 @@ struct Timestamp {
     clock_delta_t delta{};
 };
 
+// Where an entity was before the latest tick, rendering blends from this towards the current state
+struct PreviousTransform {
+    Position position;
+    Orientation orientation;
+};
+
+struct SimulationClock {
+    clock_delta_t tickDelta;
+    tick_t tick{};
+    // Real time that has passed but not been simulated yet, always less than a tick after a frame
+    clock_delta_t accumulator{};
+    clock_point_t lastPoint;
+    // How far between the previous and the latest tick the frame being rendered is
+    double alpha{};
+
+    [[nodiscard]] clock_point_t nextTickPoint() const {
+        return lastPoint + tickDelta - accumulator;
+    }
+};
+
 enum class Authority {
     Client,
     Server
@@ -52,6 +73,7 @@ struct LocalContext {
 
 struct RenderContext {
     std::optional<possesion_id_t> possessionId;
+    double alpha{1.0};
 };
 
 // #REFLECT()
@@ -104,6 +126,28 @@ struct Input {
     Key jump;
 };
 
+// One player's input for one tick, kept around so past ticks can be simulated again
+struct InputRecord {
+    tick_t tick;
+    entt::entity ent;
+    Input input;
+};
+
+// Everything prediction needs to put a player back to how it was at the end of a tick
+struct PlayerSnapshot {
+    tick_t tick;
+    entt::entity ent;
+    Position position;
+    LinearVelocity linVel;
+    Look look;
+    GroundedPlayerMove move;
+};
+
+// Authoritative player states the server sent, applied at the start of the next tick
+struct ServerCorrections {
+    std::vector<PlayerSnapshot> pending;
+};
+
 struct UI {
     bool isVisible;
 };
@@ -152,6 +196,10 @@ struct Inventory {
     std::array<std::optional<ent_t>, 10> items;
 };
 
+enum class PBRWorkflows {
+    MetallicRoughness = 0, SpecularGlossiness = 1
+};
+
 // #REFLECT()
 struct Material {
     vec4f baseColorFactor;
@@ -199,5 +247,31 @@ static void register_reflection() {
             .prop("display_name"_hs, "Y"sv)
             .data<&Position::z>("z"_hs)
             .prop("display_name"_hs, "Z"sv);
+    entt::meta<Orientation>()
+            .data<&Orientation::x>("x"_hs)
+            .prop("display_name"_hs, "X"sv)
+            .data<&Orientation::y>("y"_hs)
+            .prop("display_name"_hs, "Y"sv)
+            .data<&Orientation::z>("z"_hs)
+            .prop("display_name"_hs, "Z"sv)
+            .data<&Orientation::w>("w"_hs)
+            .prop("display_name"_hs, "W"sv);
+    entt::meta<LinearVelocity>()
+            .data<&LinearVelocity::x>("x"_hs)
+            .prop("display_name"_hs, "X"sv)
+            .data<&LinearVelocity::y>("y"_hs)
+            .prop("display_name"_hs, "Y"sv)
+            .data<&LinearVelocity::z>("z"_hs)
+            .prop("display_name"_hs, "Z"sv);
+    entt::meta<Look>()
+            .data<&Look::x>("x"_hs)
+            .prop("display_name"_hs, "X"sv)
+            .data<&Look::y>("y"_hs)
+            .prop("display_name"_hs, "Y"sv)
+            .data<&Look::z>("z"_hs)
+            .prop("display_name"_hs, "Z"sv);
+    entt::meta<ModelHandle>()
+            .data<&ModelHandle::value>("value"_hs)
+            .prop("display_name"_hs, "Value"sv);
     register_generated_reflection();
 }
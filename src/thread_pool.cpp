@@ -0,0 +1,84 @@
+#include "thread_pool.hpp"
+
+// Which pool and queue the current thread works on, lets submissions from a worker stay local
+thread_local ThreadPool const* tCurrentPool = nullptr;
+thread_local size_t tCurrentWorkerIdx = 0;
+
+ThreadPool::ThreadPool(size_t threadCount) {
+    GAME_ASSERT(threadCount > 0);
+    mQueues.reserve(threadCount);
+    for (size_t i = 0; i < threadCount; ++i) {
+        mQueues.push_back(std::make_unique<WorkQueue>());
+    }
+    mWorkers.reserve(threadCount);
+    for (size_t i = 0; i < threadCount; ++i) {
+        mWorkers.emplace_back(&ThreadPool::work, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard lock{mSleepMutex};
+        mIsStopping = true;
+    }
+    mCondition.notify_all();
+    for (std::thread& worker: mWorkers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::post(std::function<void()> task) {
+    size_t queueIdx = tCurrentPool == this ? tCurrentWorkerIdx : mNextQueue.fetch_add(1, std::memory_order_relaxed) % mQueues.size();
+    {
+        std::lock_guard lock{mQueues[queueIdx]->mutex};
+        mQueues[queueIdx]->tasks.push_back(std::move(task));
+    }
+    {
+        std::lock_guard lock{mSleepMutex};
+        mQueuedCount++;
+    }
+    mCondition.notify_one();
+}
+
+bool ThreadPool::tryPop(size_t workerIdx, std::function<void()>& task) {
+    {
+        WorkQueue& own = *mQueues[workerIdx];
+        std::lock_guard lock{own.mutex};
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+    for (size_t offset = 1; offset < mQueues.size(); ++offset) {
+        WorkQueue& victim = *mQueues[(workerIdx + offset) % mQueues.size()];
+        std::lock_guard lock{victim.mutex};
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::work(size_t workerIdx) {
+    tCurrentPool = this;
+    tCurrentWorkerIdx = workerIdx;
+    while (!mIsStopping) {
+        std::function<void()> task;
+        if (tryPop(workerIdx, task)) {
+            mQueuedCount--;
+            task();
+            continue;
+        }
+
+        std::unique_lock lock{mSleepMutex};
+        mCondition.wait(lock, [this] { return mIsStopping || mQueuedCount > 0; });
+    }
+}
+
+size_t ThreadPool::defaultThreadCount() {
+    unsigned int hardwareCount = std::thread::hardware_concurrency();
+    return hardwareCount > 1 ? hardwareCount - 1 : 1;
+}
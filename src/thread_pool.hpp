@@ -0,0 +1,71 @@
+#pragma once
+
+#include "game_pch.hpp"
+
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <future>
+#include <thread>
+#include <functional>
+#include <condition_variable>
+
+/**
+ * @brief Worker threads that each own a task queue and steal from the others when theirs runs dry.
+ *
+ * Tasks submitted from a worker go to the back of its own queue and are popped from there, so follow up work stays hot in cache.
+ * Tasks submitted from anywhere else are spread over the queues round robin. Thieves take from the front.
+ * Tasks still queued when the pool is destroyed are dropped, their futures report a broken promise.
+ */
+class ThreadPool {
+private:
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<WorkQueue>> mQueues;
+    std::vector<std::thread> mWorkers;
+    std::atomic<size_t> mNextQueue{0};
+    // Guards sleeping and waking, the count is only incremented with it held so a wakeup is never missed
+    std::mutex mSleepMutex;
+    std::condition_variable mCondition;
+    std::atomic<size_t> mQueuedCount{0};
+    std::atomic<bool> mIsStopping = false;
+
+    void work(size_t workerIdx);
+
+    bool tryPop(size_t workerIdx, std::function<void()>& task);
+
+public:
+    explicit ThreadPool(size_t threadCount = defaultThreadCount());
+
+    ThreadPool(ThreadPool const&) = delete;
+
+    ThreadPool& operator=(ThreadPool const&) = delete;
+
+    ~ThreadPool();
+
+    /** @brief Queues a task without a future, it must not throw */
+    void post(std::function<void()> task);
+
+    /**
+     * @return  Future holding the result of the task, or the exception it threw
+     */
+    template<std::invocable TFunc>
+    std::future<std::invoke_result_t<TFunc>> submit(TFunc&& func) {
+        using result_t = std::invoke_result_t<TFunc>;
+        // std::function must be copyable, so the move-only packaged task is shared instead
+        auto task = std::make_shared<std::packaged_task<result_t()>>(std::forward<TFunc>(func));
+        std::future<result_t> future = task->get_future();
+        post([task] { (*task)(); });
+        return future;
+    }
+
+    [[nodiscard]] size_t size() const {
+        return mWorkers.size();
+    }
+
+    /** @brief Leaves one hardware thread for the main loop */
+    static size_t defaultThreadCount();
+};
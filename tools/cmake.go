@@ -17,6 +17,8 @@ type Package struct {
 	Includes  []string `json:"includes"`
 	Libraries []string `json:"libraries"`
 	Source    []string `json:"source"`
+	// Only needed for the windowed client, the dedicated server neither compiles nor links it
+	ClientOnly bool `json:"clientOnly"`
 }
 
 func main() {
@@ -80,13 +82,23 @@ find_package(Vulkan REQUIRED)
 
 `)
 	_, _ = cmakeFile.WriteString(`file(GLOB_RECURSE SOURCE_FILES CONFIGURE_DEPENDS "*.cpp")
+list(FILTER SOURCE_FILES EXCLUDE REGEX "^${PROJECT_SOURCE_DIR}/server/")
+# The dedicated server only simulates, so it leaves out everything to do with windows, input and rendering
+set(SERVER_SOURCE_FILES ${SOURCE_FILES})
+list(FILTER SERVER_SOURCE_FILES EXCLUDE REGEX "^${PROJECT_SOURCE_DIR}/(graphics/|input\\.cpp|inspector\\.cpp|main\\.cpp)")
+file(GLOB_RECURSE SERVER_MAIN_FILES CONFIGURE_DEPENDS "server/*.cpp")
+list(APPEND SERVER_SOURCE_FILES ${SERVER_MAIN_FILES})
 `)
 	for pkgName, pkg := range packages {
 		for _, source := range pkg.Source {
 			_, _ = cmakeFile.WriteString(fmt.Sprintf("list(APPEND SOURCE_FILES ../pkg/%s/%s)\n", pkgName, source))
+			if !pkg.ClientOnly {
+				_, _ = cmakeFile.WriteString(fmt.Sprintf("list(APPEND SERVER_SOURCE_FILES ../pkg/%s/%s)\n", pkgName, source))
+			}
 		}
 	}
-	_, _ = cmakeFile.WriteString("add_executable(${PROJECT_NAME} ${SOURCE_FILES})\n\n")
+	_, _ = cmakeFile.WriteString("add_executable(${PROJECT_NAME} ${SOURCE_FILES})\n")
+	_, _ = cmakeFile.WriteString("add_executable(${PROJECT_NAME}_server ${SERVER_SOURCE_FILES})\n\n")
 
 	for pkgName := range packages {
 		if _, err := os.Stat(filepath.Join("pkg", pkgName, "CMakeLists.txt")); err == nil {
@@ -97,12 +109,17 @@ find_package(Vulkan REQUIRED)
 	_, _ = cmakeFile.WriteString(`
 target_include_directories(${PROJECT_NAME} PRIVATE ${PROJECT_SOURCE_DIR})
 target_precompile_headers(${PROJECT_NAME} PRIVATE "game_pch.hpp" "../pkg/imgui/imgui.h")
+target_include_directories(${PROJECT_NAME}_server PRIVATE ${PROJECT_SOURCE_DIR})
+target_precompile_headers(${PROJECT_NAME}_server PRIVATE "game_pch.hpp")
 
 `)
 
 	for pkgName, pkg := range packages {
 		for _, include := range pkg.Includes {
 			_, _ = cmakeFile.WriteString(fmt.Sprintf("target_include_directories(${PROJECT_NAME} SYSTEM PUBLIC ../pkg/%s/%s)\n", pkgName, include))
+			if !pkg.ClientOnly {
+				_, _ = cmakeFile.WriteString(fmt.Sprintf("target_include_directories(${PROJECT_NAME}_server SYSTEM PUBLIC ../pkg/%s/%s)\n", pkgName, include))
+			}
 		}
 	}
 
@@ -117,13 +134,24 @@ target_compile_definitions(tinygltf INTERFACE TINYGLTF_USE_CPP14)
 	for _, pkg := range packages {
 		for _, library := range pkg.Libraries {
 			_, _ = cmakeFile.WriteString(fmt.Sprintf("target_link_libraries(${PROJECT_NAME} %s)\n", library))
+			if !pkg.ClientOnly {
+				_, _ = cmakeFile.WriteString(fmt.Sprintf("target_link_libraries(${PROJECT_NAME}_server %s)\n", library))
+			}
 		}
 	}
 	_, _ = cmakeFile.WriteString(`
 if (MSVC)
 	target_compile_options(${PROJECT_NAME} PRIVATE /W3 /WX)
+	target_compile_options(${PROJECT_NAME}_server PRIVATE /W3 /WX)
 else ()
 	target_compile_options(${PROJECT_NAME} PRIVATE -Wall -Wextra -Wpedantic)
+	target_compile_options(${PROJECT_NAME}_server PRIVATE -Wall -Wextra -Wpedantic)
+endif ()
+if (WIN32)
+    target_compile_definitions(${PROJECT_NAME}_server PUBLIC NOMINMAX)
+    # Replication sockets
+    target_link_libraries(${PROJECT_NAME} ws2_32)
+    target_link_libraries(${PROJECT_NAME}_server ws2_32)
 endif ()
 
 target_link_libraries(${PROJECT_NAME} Vulkan::Vulkan)
@@ -135,6 +163,22 @@ elseif (APPLE)
 elseif (UNIX)
 	target_compile_definitions(${PROJECT_NAME} PUBLIC VK_USE_PLATFORM_XCB_KHR)
 endif ()
+
+# Precompile shaders next to their sources when the validator is around, the runtime falls back to compiling and caching them itself
+find_program(GLSLANG_VALIDATOR glslangValidator HINTS $ENV{VULKAN_SDK}/bin)
+if (GLSLANG_VALIDATOR)
+    file(GLOB SHADER_FILES CONFIGURE_DEPENDS "../assets/shaders/*.vert" "../assets/shaders/*.frag" "../assets/shaders/*.comp")
+    foreach (SHADER_FILE ${SHADER_FILES})
+        add_custom_command(
+                OUTPUT ${SHADER_FILE}.spv
+                COMMAND ${GLSLANG_VALIDATOR} -V ${SHADER_FILE} -o ${SHADER_FILE}.spv
+                DEPENDS ${SHADER_FILE}
+        )
+        list(APPEND SPIRV_FILES ${SHADER_FILE}.spv)
+    endforeach ()
+    add_custom_target(shaders ALL DEPENDS ${SPIRV_FILES})
+    add_dependencies(${PROJECT_NAME} shaders)
+endif ()
 `)
 
 	err = cmakeFile.Close()